@@ -0,0 +1,3 @@
+#!/bin/bash
+
+gcc -O3 -lOpenCL -Wall -Werror main.c -o a.out
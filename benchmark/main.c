@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "easycl.h"
+#include "../examples/mandelbrot/mandelbrot.h"
+
+// results are printed as csv: benchmark,param,value,unit
+// mandelbrot kernel and its cpu version are taken from examples/mandelbrot
+
+#define MANDELBROT_CL "../examples/mandelbrot/main.cl"
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+EclError_t bench_transfer(const EclComputer_t* comp) {
+    size_t maxSize = 64 << 20;
+    uint8_t* data = malloc(maxSize);
+    if(!data) return ECL_ERROR_OUT_OF_MEMORY;
+
+    memset(data, 1, maxSize);
+
+    EclError_t err = ECL_ERROR_OK;
+
+    for(size_t size = 4 << 10; size <= maxSize && err == ECL_ERROR_OK; size <<= 2) {
+        EclBuffer_t buf = {.data = data, .size = size, .access = ECL_BUFFER_READ_WRITE};
+
+        // first send allocates device memory
+        err = eclComputerSend(&buf, comp, ECL_EXEC_SYNC);
+        if(err != ECL_ERROR_OK) {
+            eclBufferClear(&buf);
+            break;
+        }
+
+        size_t repeats = (256 << 20) / size;
+        if(repeats > 1000) repeats = 1000;
+
+        double start = now();
+        for(size_t i = 0; i < repeats; i++)
+            eclComputerSend(&buf, comp, ECL_EXEC_SYNC);
+        double send = (now() - start) / repeats;
+
+        start = now();
+        for(size_t i = 0; i < repeats; i++)
+            eclComputerReceive(&buf, comp, ECL_EXEC_SYNC);
+        double receive = (now() - start) / repeats;
+
+        printf("send,%zu,%.3f,GB/s\n", size, size / send * 1e-9);
+        printf("receive,%zu,%.3f,GB/s\n", size, size / receive * 1e-9);
+
+        eclBufferClear(&buf);
+    }
+
+    free(data);
+    return err;
+}
+
+EclError_t bench_latency(EclProgram_t* prog, const EclComputer_t* comp) {
+    EclKernel_t kern = {.name = "empty"};
+    EclFrame_t frame = {.prog = prog, .kern = &kern};
+
+    EclWorkSize_t global = {.dim = 1, .sizes = {1}};
+    EclWorkSize_t local = {.dim = 1, .sizes = {1}};
+
+    // warm up, builds program
+    EclError_t err = eclComputerGrid(&frame, global, local, comp, ECL_EXEC_SYNC);
+    if(err != ECL_ERROR_OK) return err;
+
+    size_t repeats = 10000;
+
+    double start = now();
+    for(size_t i = 0; i < repeats; i++)
+        eclComputerGrid(&frame, global, local, comp, ECL_EXEC_SYNC);
+    double sync = (now() - start) / repeats;
+
+    start = now();
+    for(size_t i = 0; i < repeats; i++)
+        eclComputerGrid(&frame, global, local, comp, ECL_EXEC_ASYNC);
+    eclComputerAwait(comp);
+    double async = (now() - start) / repeats;
+
+    printf("grid_latency,sync,%.3f,us\n", sync * 1e6);
+    printf("grid_latency,async,%.3f,us\n", async * 1e6);
+
+    eclKernelClear(&kern);
+    return ECL_ERROR_OK;
+}
+
+EclError_t bench_build(const EclComputer_t* comp) {
+    size_t repeats = 5;
+    double total = 0;
+
+    for(size_t i = 0; i < repeats; i++) {
+        // fresh program without binary cache, so every launch compiles it
+        EclProgram_t prog = {};
+        EclError_t err = eclProgramLoad("main.cl", &prog);
+        if(err != ECL_ERROR_OK) return err;
+
+        EclKernel_t kern = {.name = "empty"};
+        EclFrame_t frame = {.prog = &prog, .kern = &kern};
+
+        double start = now();
+        err = eclComputerGrid(&frame, (EclWorkSize_t){.dim = 1, .sizes = {1}}, (EclWorkSize_t){.dim = 1, .sizes = {1}}, comp, ECL_EXEC_SYNC);
+        total += now() - start;
+
+        eclKernelClear(&kern);
+        eclProgramClear(&prog);
+
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    printf("build,main.cl,%.3f,ms\n", total / repeats * 1e3);
+    return ECL_ERROR_OK;
+}
+
+EclError_t bench_mandelbrot(const EclComputer_t* comp) {
+    uint32_t w = 2048;
+    uint32_t h = 1024;
+
+    float px = 0.65f;
+    float py = 0;
+    float mag = 1.0f;
+    uint32_t maxIter = 100;
+
+    EclProgram_t prog = {};
+    EclError_t err = eclProgramLoad(MANDELBROT_CL, &prog);
+    if(err != ECL_ERROR_OK) return err;
+
+    uint8_t* data = malloc(w * h * 3 * sizeof(uint8_t));
+    if(!data) {
+        eclProgramClear(&prog);
+        return ECL_ERROR_OUT_OF_MEMORY;
+    }
+
+    // cpu reference, same repeats as device
+    size_t repeats = 10;
+
+    double start = now();
+    for(size_t i = 0; i < repeats; i++)
+        mandelbrot_cpu(data, w, h, px, py, mag, maxIter);
+    double cpu = (now() - start) / repeats;
+
+    // device
+    EclKernel_t kern = {.name = "mandelbrot"};
+    EclBuffer_t dataBuf = {
+        .data = data,
+        .size = w * h * 3 * sizeof(uint8_t),
+        .access = ECL_BUFFER_WRITE
+    };
+
+    EclFrame_t frame = {
+        .prog = &prog,
+        .kern = &kern,
+        .args = {
+            {ECL_ARG_BUFFER, &dataBuf},
+            {ECL_ARG_VAR, &w, sizeof(uint32_t)},
+            {ECL_ARG_VAR, &h, sizeof(uint32_t)},
+            {ECL_ARG_VAR, &px, sizeof(float)},
+            {ECL_ARG_VAR, &py, sizeof(float)},
+            {ECL_ARG_VAR, &mag, sizeof(float)},
+            {ECL_ARG_VAR, &maxIter, sizeof(uint32_t)}
+        },
+        .argsCount = 7
+    };
+
+    EclWorkSize_t global = {.dim = 2, .sizes = {w, h}};
+    EclWorkSize_t local = {.dim = 2, .sizes = {64, 1}};
+
+    err = eclComputerSend(&dataBuf, comp, ECL_EXEC_SYNC);
+
+    // warm up, builds program
+    if(err == ECL_ERROR_OK) err = eclComputerGrid(&frame, global, local, comp, ECL_EXEC_SYNC);
+
+    if(err == ECL_ERROR_OK) {
+        start = now();
+        for(size_t i = 0; i < repeats; i++)
+            eclComputerGrid(&frame, global, local, comp, ECL_EXEC_ASYNC);
+        err = eclComputerAwait(comp);
+        double device = (now() - start) / repeats;
+
+        // download is measured on its own, so it doesn't bias kernel throughput
+        start = now();
+        if(err == ECL_ERROR_OK) err = eclComputerReceive(&dataBuf, comp, ECL_EXEC_SYNC);
+        double receive = now() - start;
+
+        printf("mandelbrot,cpu,%.3f,Mpix/s\n", w * h / cpu * 1e-6);
+        printf("mandelbrot,device,%.3f,Mpix/s\n", w * h / device * 1e-6);
+        printf("mandelbrot,receive,%.3f,ms\n", receive * 1e3);
+    }
+
+    eclBufferClear(&dataBuf);
+    eclKernelClear(&kern);
+    eclProgramClear(&prog);
+
+    free(data);
+    return err;
+}
+
+int main(int argc, char** argv) {
+    // cpu device by default, so it runs without gpu (e.g. pocl)
+    EclDeviceType_t type = ECL_DEVICE_CPU;
+    if(argc > 1 && !strcmp(argv[1], "gpu")) type = ECL_DEVICE_GPU;
+    if(argc > 1 && !strcmp(argv[1], "accel")) type = ECL_DEVICE_ACCEL;
+
+    size_t platID = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+
+    EclPlatform_t plat = {};
+    EclError_t err = eclGetPlatform(platID, &plat);
+    if(err != ECL_ERROR_OK) {
+        fprintf(stderr, "no platform %zu: %d\n", platID, err);
+        return 1;
+    }
+
+    EclComputer_t comp = {};
+    err = eclComputer(0, type, &plat, &comp);
+    if(err != ECL_ERROR_OK) {
+        fprintf(stderr, "no device: %d\n", err);
+        return 1;
+    }
+
+    EclProgram_t prog = {};
+    err = eclProgramLoad("main.cl", &prog);
+    if(err != ECL_ERROR_OK) {
+        fprintf(stderr, "can't load main.cl: %d\n", err);
+        return 1;
+    }
+
+    printf("benchmark,param,value,unit\n");
+    printf("device,%s,%zu,cu\n", comp.dev->name, comp.dev->cu);
+
+    if(err == ECL_ERROR_OK) err = bench_transfer(&comp);
+    if(err == ECL_ERROR_OK) err = bench_latency(&prog, &comp);
+    if(err == ECL_ERROR_OK) err = bench_build(&comp);
+    if(err == ECL_ERROR_OK) err = bench_mandelbrot(&comp);
+
+    if(err != ECL_ERROR_OK) fprintf(stderr, "benchmark failed: %d\n", err);
+
+    // clean resources
+    eclProgramClear(&prog);
+
+    eclComputerClear(&comp);
+    eclPlatformClear(&plat);
+
+    return err == ECL_ERROR_OK ? 0 : 1;
+}
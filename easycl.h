@@ -2,24 +2,60 @@
 #define _EASYCL_H_
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <math.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <stdatomic.h>
 
 #define CL_TARGET_OPENCL_VERSION 200
 #include "CL/cl.h"
 
+// vendor queries of simd width, see cl_ext.h
+#ifndef CL_DEVICE_WARP_SIZE_NV
+#define CL_DEVICE_WARP_SIZE_NV 0x4003
+#endif
+#ifndef CL_DEVICE_WAVEFRONT_WIDTH_AMD
+#define CL_DEVICE_WAVEFRONT_WIDTH_AMD 0x4043
+#endif
+
 #define ECL_MAX_PLATFORMS_COUNT 32
 #define ECL_MAX_DEVICES_COUNT 32
 
 #define ECL_MAX_WORKITEMS_DIMENSION 16
 
 #define ECL_MAX_STRING_LEN 512
-#define ECL_MAX_MAP_SIZE 32
+#define ECL_MAX_NAME_LEN 64
+#define ECL_MAX_VEC_VARIANTS 4
 #define ECL_MAX_ARRAY_SIZE 32
 
+#define ECL_MAX_PRIM_GROUP 256 // work-group size limit of primitives
+#define ECL_MAX_HISTOGRAM_BINS 4096 // bins are counted in local memory
+
 #define ECL_MAX_PROGRAM_LEN 2048
+#define ECL_MAX_VAR_SIZE 64
+
+#define ECL_POOL_SLAB_SIZE (64 << 20)
+#define ECL_POOL_MIN_CLASS 256
+#define ECL_POOL_CLASSES 32
+
+#define ECL_COMPLETIONS_SIZE 1024 // default completion queue capacity
+#define ECL_PROFILE_RECORDS 65536 // default profiler capacity
+
+#define ECL_HASH_SEED 14695981039346656037ULL
+#define ECL_HASH_PRIME 1099511628211ULL
 
 // "_some" means "hidden from user"
 
@@ -43,7 +79,17 @@ typedef enum {
     ECL_ERROR_NO_COMPILER,
     ECL_ERROR_CREATE_KERNEL,
     ECL_ERROR_NO_KERNEL,
-    ECL_ERROR_INVALID_ARG_SIZE
+    ECL_ERROR_INVALID_ARG_SIZE,
+    ECL_ERROR_INVALID_OPTIONS,
+    ECL_ERROR_INVALID_EVENTS,
+    ECL_ERROR_WRITE_FILE,
+    ECL_ERROR_NO_SVM,
+    ECL_ERROR_INVALID_IMAGE_FORMAT,
+    ECL_ERROR_MAP_FILE,
+    ECL_ERROR_INVALID_PIPELINE,
+    ECL_ERROR_OUT_OF_LOCAL_MEMORY,
+    ECL_ERROR_CREATE_COMPLETIONS,
+    ECL_ERROR_COMPLETIONS_FULL
 } EclError_t;
 
 typedef struct {
@@ -55,38 +101,66 @@ typedef enum {
     ECL_DEVICE_CPU = CL_DEVICE_TYPE_CPU,
     ECL_DEVICE_GPU = CL_DEVICE_TYPE_GPU,
     ECL_DEVICE_ACCEL = CL_DEVICE_TYPE_ACCELERATOR,
+    ECL_DEVICE_HOST = 1 << 30 // native threads, no OpenCL
 } EclDeviceType_t;
 
+typedef enum {
+    ECL_VEC_CHAR = 0,
+    ECL_VEC_SHORT,
+    ECL_VEC_INT,
+    ECL_VEC_LONG,
+    ECL_VEC_FLOAT,
+    ECL_VEC_DOUBLE,
+    ECL_VEC_HALF,
+    ECL_VEC_TYPES_COUNT
+} EclVecType_t;
+
 typedef struct {
     EclDeviceType_t type;
 
     char name[ECL_MAX_STRING_LEN];
     char ext[ECL_MAX_STRING_LEN];
     char ocl_ver[ECL_MAX_STRING_LEN];
+    char drv_ver[ECL_MAX_STRING_LEN];
 
     size_t cu; // max compute units
     size_t wrkgSize; // max workgroup size
+    size_t globalMem; // global memory bytes
+    size_t maxAlloc; // max bytes of one buffer
+    size_t localMem; // local memory bytes per work-group
+    size_t cacheLine; // global memory cache line bytes
+    size_t simd; // work-items executed together (warp, wavefront), 1 if unknown
+    size_t vecWidth[ECL_VEC_TYPES_COUNT]; // preferred vector widths, 0 if type isn't supported
+    bool unified; // device shares memory with host
+    cl_device_svm_capabilities svm; // shared virtual memory support, 0 if none
 
     EclWorkSize_t wrki; // max workitems sizes
 
     cl_device_id _id;
 } EclDevice_t;
 
+// process-wide registry entry, queried on first use and never moved
 typedef struct {
-    char name[ECL_MAX_STRING_LEN];
-    char ocl_ver[ECL_MAX_STRING_LEN];
-    char ext[ECL_MAX_STRING_LEN];
-
     cl_platform_id _id;
 
-    size_t cpuCount;
-    EclDevice_t cpu[ECL_MAX_DEVICES_COUNT];
+    char _name[ECL_MAX_STRING_LEN];
+    char _ocl_ver[ECL_MAX_STRING_LEN];
+    char _ext[ECL_MAX_STRING_LEN];
+    bool _info; // strings are queried
+
+    // cpu, gpu and accel devices, every type is enumerated separately
+    bool _loaded[3];
+    size_t _devicesSize[3];
+    EclDevice_t* _devices[3];
+} _EclPlatformEntry_t;
 
-    size_t gpuCount;
-    EclDevice_t gpu[ECL_MAX_DEVICES_COUNT];
+typedef struct {
+    const char* name;
+    const char* ocl_ver;
+    const char* ext;
 
-    size_t accelCount;
-    EclDevice_t accel[ECL_MAX_DEVICES_COUNT];
+    cl_platform_id _id;
+    _EclPlatformEntry_t* _entry;
 } EclPlatform_t;
 
 typedef enum {
@@ -94,32 +168,234 @@ typedef enum {
     ECL_EXEC_ASYNC
 } EclComputerExec_t;
 
+typedef struct {
+    cl_event _ev;
+} EclEvent_t;
+
+typedef enum {
+    ECL_QUEUE_SINGLE = 0, // one in-order queue
+    ECL_QUEUE_SPLIT, // dedicated upload, compute and download queues
+    ECL_QUEUE_OUT_OF_ORDER // one out-of-order queue
+} EclQueueMode_t;
+
+// per-object spinlock of thread-safe mode, zero is unlocked
+typedef atomic_uint _EclLock_t;
+
+// growable hash map for per-context objects, entries start with uint64_t key
+typedef struct {
+    void** _items; // entries are allocated separately, so pointers to them stay valid
+    size_t _size;
+    size_t _cap;
+
+    size_t* _slots; // open addressing, entry index + 1
+    size_t _slotsCap;
+} _EclMap_t;
+
+typedef struct {
+    size_t reserved; // bytes in slabs
+    size_t allocated; // bytes of size classes given to buffers
+    size_t inUse; // bytes requested by buffers
+    size_t cached; // bytes in free lists
+
+    double fragmentation; // share of reserved bytes not requested by buffers
+    double hitRate; // share of allocations served from free lists
+} EclPoolStats_t;
+
+typedef struct {
+    cl_mem _mem;
+    size_t _size;
+    size_t _used;
+} _EclPoolSlab_t;
+
+typedef struct {
+    cl_mem _mem;
+    cl_mem_flags _flags; // access of sub-buffer
+    cl_event _ev; // last command of previous owner, next owner waits for it
+} _EclPoolRegion_t;
+
+typedef struct {
+    _EclPoolRegion_t* _regions;
+    size_t _size;
+    size_t _cap;
+} _EclPoolFreeList_t;
+
+typedef struct {
+    size_t slabSize; // 0 means ECL_POOL_SLAB_SIZE
+
+    cl_context _ctx;
+    size_t _align;
+
+    _EclPoolSlab_t* _slabs;
+    size_t _slabsSize;
+    size_t _slabsCap;
+
+    _EclPoolFreeList_t _free[ECL_POOL_CLASSES];
+
+    size_t _hits;
+    size_t _misses;
+    size_t _allocated;
+    size_t _inUse;
+
+    _EclLock_t _lock;
+} EclPool_t;
+
+typedef enum {
+    ECL_PROFILE_SEND = 0,
+    ECL_PROFILE_GRID,
+    ECL_PROFILE_RECEIVE
+} EclProfileOp_t;
+
+typedef struct {
+    EclProfileOp_t op;
+    const char* name; // kernel name for grid, stored once per kernel by profiler
+    const EclDevice_t* dev;
+    size_t bytes; // transferred bytes
+
+    // device time, ns
+    cl_ulong queued;
+    cl_ulong submit;
+    cl_ulong start;
+    cl_ulong end;
+
+    cl_event _ev; // pending until collected
+} EclProfileRecord_t;
+
+typedef struct {
+    uint64_t _key;
+    char name[ECL_MAX_STRING_LEN];
+} _EclProfileName_t;
+
+typedef struct {
+    EclProfileOp_t op;
+    char name[ECL_MAX_STRING_LEN];
+    size_t count;
+    size_t bytes;
+
+    // execution time, ns
+    double total;
+    double min;
+    double max;
+    double wait; // from queued to start
+} EclProfileStats_t;
+
+// records are kept in a ring, oldest ones are dropped when it is full
+typedef struct {
+    size_t capacity; // max records, 0 means ECL_PROFILE_RECORDS
+
+    EclProfileRecord_t* records; // unordered
+    size_t recordsSize;
+    size_t _recordsCap;
+
+    size_t _head; // records ever added
+    size_t _tail; // oldest record which may still hold event
+
+    _EclMap_t _names;
+    _EclLock_t _lock;
+} EclProfiler_t;
+
+// work-item of host kernel, like get_global_id and others in OpenCL
+typedef struct {
+    size_t dim;
+    size_t global[3];
+    size_t local[3];
+    size_t group[3];
+    size_t globalSize[3];
+    size_t localSize[3];
+    size_t offset[3];
+} EclWorkItem_t;
+
+// args are buffers data or vars pointers in frame order
+typedef void (*EclHostKernel_t)(const EclWorkItem_t* item, void* const* args);
+
+typedef struct {
+    void* _pool; // _EclHostPool_t
+    size_t _id;
+
+    // work-groups owned by thread, others steal half from the end
+    pthread_mutex_t _lock;
+    size_t _begin;
+    size_t _end;
+} _EclHostQueue_t;
+
+typedef struct {
+    size_t _threadsSize;
+    pthread_t* _threads;
+    _EclHostQueue_t* _queues; // caller is worker 0
+
+    pthread_mutex_t _launch; // one grid at a time
+    pthread_mutex_t _lock;
+    pthread_cond_t _start;
+    pthread_cond_t _done;
+    size_t _generation;
+    size_t _running;
+    bool _stop;
+
+    // current grid
+    EclHostKernel_t _fn;
+    void* const* _args;
+    EclWorkItem_t _grid;
+    size_t _groups[3];
+} _EclHostPool_t;
+
 typedef struct {
     const EclDevice_t* dev;
+    EclQueueMode_t queues;
+    EclPool_t* pool; // buffers are allocated from pool if set
+    EclProfiler_t* prof; // queues are created with profiling and every command is recorded if set
+
     cl_context _ctx;
-    cl_command_queue _queue;
+    cl_command_queue _queue; // compute
+    cl_command_queue _upload;
+    cl_command_queue _download;
+
+    _EclHostPool_t* _host; // host device threads
 } EclComputer_t;
 
 typedef struct {
+    uint64_t _key;
     cl_context _ctx;
+    uint64_t _opts; // build options hash
     cl_program _prog;
 } _EclProgramMap_t;
 
+typedef struct {
+    char dir[ECL_MAX_STRING_LEN]; // directory for program binaries
+
+    size_t hits; // programs loaded from binaries
+    size_t misses; // programs built from source
+
+    _EclLock_t _lock;
+} EclProgramCache_t;
+
 typedef struct {
     size_t _progSize;
-    _EclProgramMap_t _prog[ECL_MAX_MAP_SIZE];
+    _EclProgramMap_t _prog; // first variant
+    _EclMap_t _progMap; // other variants
+    _EclLock_t _lock;
     char src[ECL_MAX_PROGRAM_LEN];
+    char options[ECL_MAX_STRING_LEN]; // build options for every frame
+    EclProgramCache_t* cache;
 } EclProgram_t;
 
 typedef struct {
+    uint64_t _key;
     cl_program _prog;
-    cl_kernel _kern;
+    cl_kernel _kern; // 0 after thread released it
+    uintptr_t _thread;
 } _EclKernelMap_t;
 
 typedef struct {
     size_t _kernSize;
-    _EclKernelMap_t _kern[ECL_MAX_MAP_SIZE];
+    _EclKernelMap_t _kern; // first program
+    _EclMap_t _kernMap; // other programs
+    _EclLock_t _lock;
+    EclHostKernel_t host; // kernel for host computers
     char name[ECL_MAX_STRING_LEN];
+
+    // vector variants, "name<width>" (e.g. "saxpy8") handles width items along first axis,
+    // widest one fitting device preferred width of vecType and grid is launched
+    size_t vec[ECL_MAX_VEC_VARIANTS];
+    EclVecType_t vecType;
 } EclKernel_t;
 
 typedef enum {
@@ -128,22 +404,142 @@ typedef enum {
     ECL_BUFFER_READ_WRITE = CL_MEM_READ_WRITE
 } EclBufferAccess_t;
 
+typedef enum {
+    ECL_BUFFER_DEVICE = 0, // device memory, Send/Receive copy data
+    ECL_BUFFER_HOST, // device uses data directly on unified memory devices
+    ECL_BUFFER_PINNED // host accessible memory allocated by driver, data is provided by eclComputerMap
+} EclBufferMemory_t;
+
 typedef struct {
+    uint64_t _key;
     cl_context _ctx;
     cl_mem _mem;
+    cl_event _ev; // last command using the buffer, if queues are not in-order
+    _EclLock_t _evLock;
+
+    bool _zero; // zero-copy, Send/Receive unmap/map buffer
+    bool _mapped;
+    void* _ptr;
+    cl_command_queue _queue; // queue of last map
+
+    EclPool_t* _pool;
+    size_t _class;
+    size_t _size;
 } _EclBufferMap_t;
 
 typedef struct {
     size_t _bufSize;
-    _EclBufferMap_t _buf[ECL_MAX_MAP_SIZE];
+    _EclBufferMap_t _buf; // first context
+    _EclMap_t _bufMap; // other contexts
+    _EclLock_t _lock;
     void* data;
     size_t size;
     EclBufferAccess_t access;
+    EclBufferMemory_t memory;
 } EclBuffer_t;
 
+typedef enum {
+    ECL_CHANNELS_R = CL_R,
+    ECL_CHANNELS_RG = CL_RG,
+    ECL_CHANNELS_RGBA = CL_RGBA,
+    ECL_CHANNELS_BGRA = CL_BGRA
+} EclImageChannels_t;
+
+typedef enum {
+    ECL_CHANNEL_UNORM8 = CL_UNORM_INT8, // read as float in [0, 1]
+    ECL_CHANNEL_UNORM16 = CL_UNORM_INT16,
+    ECL_CHANNEL_UINT8 = CL_UNSIGNED_INT8,
+    ECL_CHANNEL_UINT16 = CL_UNSIGNED_INT16,
+    ECL_CHANNEL_UINT32 = CL_UNSIGNED_INT32,
+    ECL_CHANNEL_INT32 = CL_SIGNED_INT32,
+    ECL_CHANNEL_HALF = CL_HALF_FLOAT,
+    ECL_CHANNEL_FLOAT = CL_FLOAT
+} EclImageChannelType_t;
+
+typedef struct {
+    EclImageChannels_t channels;
+    EclImageChannelType_t type;
+} EclImageFormat_t;
+
+typedef struct {
+    size_t _imgSize;
+    _EclBufferMap_t _img; // first context
+    _EclMap_t _imgMap; // other contexts
+    _EclLock_t _lock;
+
+    void* data;
+    size_t width;
+    size_t height;
+    size_t depth; // 0 or 1 for 2D image
+    size_t rowPitch; // host bytes per row, 0 means tightly packed
+    size_t slicePitch; // host bytes per slice, 0 means tightly packed
+
+    EclImageFormat_t format;
+    EclBufferAccess_t access;
+} EclImage_t;
+
+typedef enum {
+    ECL_ADDRESS_NONE = CL_ADDRESS_NONE,
+    ECL_ADDRESS_CLAMP_TO_EDGE = CL_ADDRESS_CLAMP_TO_EDGE,
+    ECL_ADDRESS_CLAMP = CL_ADDRESS_CLAMP,
+    ECL_ADDRESS_REPEAT = CL_ADDRESS_REPEAT
+} EclSamplerAddress_t;
+
+typedef enum {
+    ECL_FILTER_NEAREST = CL_FILTER_NEAREST,
+    ECL_FILTER_LINEAR = CL_FILTER_LINEAR
+} EclSamplerFilter_t;
+
+typedef struct {
+    uint64_t _key;
+    cl_sampler _sampler;
+} _EclSamplerMap_t;
+
+typedef struct {
+    size_t _samplerSize;
+    _EclSamplerMap_t _sampler; // first context
+    _EclMap_t _samplerMap; // other contexts
+    _EclLock_t _lock;
+
+    bool normalized; // coordinates in [0, 1]
+    EclSamplerAddress_t address;
+    EclSamplerFilter_t filter;
+} EclSampler_t;
+
+typedef enum {
+    ECL_SVM_COARSE = 0, // host may access memory only when mapped
+    ECL_SVM_FINE, // host and device access memory at any time, synchronized by kernel completion
+    ECL_SVM_FINE_ATOMICS // also synchronized by atomics
+} EclSvmMode_t;
+
+typedef struct {
+    void* data; // same pointer on host and device
+    size_t size;
+    EclBufferAccess_t access;
+    EclSvmMode_t mode;
+
+    cl_context _ctx;
+    const EclComputer_t* _comp;
+    cl_event _ev; // last map or unmap, when queues are tracked
+    bool _mapped;
+    bool _host; // allocated for host computer
+} EclSvm_t;
+
+typedef struct {
+    size_t origin[3]; // offset in bytes, rows and slices
+    size_t region[3]; // size in bytes, rows and slices
+    size_t rowPitch; // bytes per row of buffer, 0 means region[0]
+    size_t slicePitch; // bytes per slice of buffer, 0 means rowPitch * region[1]
+} EclRect_t;
+
 typedef enum {
     ECL_ARG_VAR = 0,
-    ECL_ARG_BUFFER
+    ECL_ARG_BUFFER,
+    ECL_ARG_SVM,
+    ECL_ARG_IMAGE,
+    ECL_ARG_SAMPLER,
+    ECL_ARG_LOCAL, // local memory of size bytes, arg is unused
+    ECL_ARG_LOCAL_ITEMS // local memory of size bytes per work-item of work-group
 } EclFrameArgType_t;
 
 typedef struct {
@@ -158,6 +554,8 @@ typedef struct {
 
     EclFrameArg_t args[ECL_MAX_ARRAY_SIZE];
     size_t argsCount;
+
+    char options[ECL_MAX_STRING_LEN]; // build options appended to program ones
 } EclFrame_t;
 
 EclError_t eclGetPlatformsCount(size_t* out);
@@ -171,15 +569,262 @@ EclError_t eclComputer(size_t devID, EclDeviceType_t type, EclPlatform_t* platfo
 EclError_t eclComputerSend(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec);
 EclError_t eclComputerGrid(EclFrame_t* frame, EclWorkSize_t global, EclWorkSize_t local, const EclComputer_t* comp, EclComputerExec_t exec);
 EclError_t eclComputerReceive(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclComputerMap(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec);
+
+EclError_t eclComputerSendRange(EclBuffer_t* arg, size_t offset, size_t size, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclComputerReceiveRange(EclBuffer_t* arg, size_t offset, size_t size, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclComputerSendRect(EclBuffer_t* arg, const EclRect_t* rect, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclComputerReceiveRect(EclBuffer_t* arg, const EclRect_t* rect, const EclComputer_t* comp, EclComputerExec_t exec);
 EclError_t eclComputerAwait(const EclComputer_t* comp);
+
+EclError_t eclComputerSendEx(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec, const EclEvent_t* wait, size_t waitCount, EclEvent_t* event);
+EclError_t eclComputerGridEx(EclFrame_t* frame, EclWorkSize_t global, EclWorkSize_t local, const EclComputer_t* comp, EclComputerExec_t exec, const EclEvent_t* wait, size_t waitCount, EclEvent_t* event);
+EclError_t eclComputerReceiveEx(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec, const EclEvent_t* wait, size_t waitCount, EclEvent_t* event);
 EclError_t eclComputerClear(EclComputer_t* comp);
 
 EclError_t eclProgramLoad(const char* filename, EclProgram_t* out);
+EclError_t eclProgramDefine(EclProgram_t* prog, const char* name, const char* fmt, ...);
+EclError_t eclFrameDefine(EclFrame_t* frame, const char* name, const char* fmt, ...);
 EclError_t eclProgramClear(EclProgram_t* prog);
 EclError_t eclKernelClear(EclKernel_t* kern);
+EclError_t eclKernelClearThread(EclKernel_t* kern);
 
 EclError_t eclBufferClear(EclBuffer_t* arg);
 
+EclError_t eclComputerSendImage(EclImage_t* img, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclComputerReceiveImage(EclImage_t* img, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclImageClear(EclImage_t* img);
+EclError_t eclSamplerClear(EclSampler_t* sampler);
+
+EclError_t eclSvmAlloc(EclSvm_t* svm, const EclComputer_t* comp);
+EclError_t eclSvmMap(EclSvm_t* svm, EclComputerExec_t exec);
+EclError_t eclSvmUnmap(EclSvm_t* svm, EclComputerExec_t exec);
+EclError_t eclSvmClear(EclSvm_t* svm);
+
+typedef struct {
+    EclFrame_t* frame;
+    size_t inArg; // frame arg bound to input chunk
+    size_t outArg; // frame arg bound to output chunk
+
+    const void* in; // may be NULL
+    size_t inStride; // input bytes per item
+    void* out; // may be NULL
+    size_t outStride; // output bytes per item
+
+    size_t count; // items count, multiple of local size along axis
+    size_t chunk; // items per chunk, 0 means sized to device memory
+
+    size_t axis; // global dimension of items
+    EclWorkSize_t global; // chunk grid, sizes[axis] is set for every chunk
+    EclWorkSize_t local;
+    bool offset; // chunk grid is offset by its first item, so get_global_id gives item index in whole range
+} EclStream_t;
+
+EclError_t eclComputerStream(EclStream_t* stream, const EclComputer_t* comp);
+
+typedef struct {
+    void* data;
+    size_t size; // created or resized to size if write is set and size isn't 0
+    bool write; // changes are written to file
+} EclFile_t;
+
+EclError_t eclFileMap(const char* filename, EclFile_t* file);
+EclError_t eclFileClear(EclFile_t* file);
+
+typedef struct {
+    EclFrame_t* frame;
+    EclWorkSize_t global;
+    EclWorkSize_t local;
+    const EclComputer_t* comp;
+
+    cl_program _prog;
+    cl_kernel _kern; // own kernel, so args set by other launches don't interfere
+    size_t _width; // vector variant width, rechecked on launch since global and local may change
+
+    // args currently set to kernel
+    cl_mem _mem[ECL_MAX_ARRAY_SIZE];
+    size_t _sizes[ECL_MAX_ARRAY_SIZE];
+    uint8_t _vals[ECL_MAX_ARRAY_SIZE][ECL_MAX_VAR_SIZE];
+} EclPlan_t;
+
+EclError_t eclComputerPlan(EclFrame_t* frame, EclWorkSize_t global, EclWorkSize_t local, const EclComputer_t* comp, EclPlan_t* out);
+EclError_t eclPlanGrid(EclPlan_t* plan, EclComputerExec_t exec);
+EclError_t eclPlanGridEx(EclPlan_t* plan, EclComputerExec_t exec, const EclEvent_t* wait, size_t waitCount, EclEvent_t* event);
+EclError_t eclPlanClear(EclPlan_t* plan);
+
+typedef enum {
+    ECL_NODE_SEND = 0,
+    ECL_NODE_GRID,
+    ECL_NODE_RECEIVE
+} EclNodeType_t;
+
+typedef struct {
+    EclNodeType_t type;
+    EclBuffer_t* buf; // send and receive
+    EclFrame_t frame; // grid, copy of recorded frame
+    EclPlan_t plan;
+} _EclGraphNode_t;
+
+typedef struct {
+    const EclComputer_t* comp;
+
+    _EclGraphNode_t** _nodes;
+    size_t _nodesSize;
+    size_t _nodesCap;
+} EclGraph_t;
+
+EclError_t eclGraphSend(EclGraph_t* graph, EclBuffer_t* arg, size_t* node);
+EclError_t eclGraphGrid(EclGraph_t* graph, const EclFrame_t* frame, EclWorkSize_t global, EclWorkSize_t local, size_t* node);
+EclError_t eclGraphReceive(EclGraph_t* graph, EclBuffer_t* arg, size_t* node);
+EclError_t eclGraphSetArg(EclGraph_t* graph, size_t node, size_t argID, EclFrameArg_t arg);
+EclError_t eclGraphSwapBuffers(EclGraph_t* graph, EclBuffer_t* a, EclBuffer_t* b);
+EclError_t eclGraphRun(EclGraph_t* graph, EclComputerExec_t exec);
+EclError_t eclGraphClear(EclGraph_t* graph);
+
+typedef struct {
+    const EclComputer_t* comps[ECL_MAX_DEVICES_COUNT];
+    size_t count;
+
+    size_t axis; // global dimension split between computers
+    size_t strides[ECL_MAX_ARRAY_SIZE]; // bytes per item along axis for buffer args, 0 means buffer is not split
+
+    double ratio[ECL_MAX_DEVICES_COUNT]; // split weights, updated from measured throughput, all 0 means even split
+
+    // last launch
+    size_t offset[ECL_MAX_DEVICES_COUNT];
+    size_t size[ECL_MAX_DEVICES_COUNT];
+    double time[ECL_MAX_DEVICES_COUNT]; // seconds
+} EclCluster_t;
+
+EclError_t eclClusterGrid(EclFrame_t* frame, EclWorkSize_t global, EclWorkSize_t local, EclCluster_t* cluster);
+
+typedef struct {
+    uint64_t _key;
+    EclWorkSize_t local;
+} _EclTunerMap_t;
+
+typedef struct {
+    char file[ECL_MAX_STRING_LEN]; // results are loaded from and saved to file if set
+    size_t repeats; // launches per candidate, 0 means 5
+
+    _EclMap_t _results;
+    bool _loaded;
+} EclTuner_t;
+
+EclError_t eclComputerTune(EclFrame_t* frame, EclWorkSize_t global, const EclComputer_t* comp, EclTuner_t* tuner, EclWorkSize_t* local);
+EclError_t eclTunerClear(EclTuner_t* tuner);
+
+// primitives items are 32-bit
+typedef enum {
+    ECL_TYPE_INT = 0,
+    ECL_TYPE_UINT,
+    ECL_TYPE_FLOAT
+} EclType_t;
+
+typedef enum {
+    ECL_OP_SUM = 0,
+    ECL_OP_MIN,
+    ECL_OP_MAX
+} EclOp_t;
+
+typedef struct {
+    EclProgram_t _scanProg; // reduce and scan, variant per type and operation
+    EclProgram_t _sortProg; // radix sort, compaction and zeroing
+    EclProgram_t _histProg; // variant per bins count
+
+    EclKernel_t _reduce;
+    EclKernel_t _scan;
+    EclKernel_t _count;
+    EclKernel_t _scatter;
+    EclKernel_t _compact;
+    EclKernel_t _zero;
+    EclKernel_t _hist;
+
+    EclBuffer_t _sums; // group partials
+    EclBuffer_t _counts; // radix digits per group
+    EclBuffer_t _tmp; // item per input, sort ping-pong or compaction positions
+} EclPrimitives_t;
+
+EclError_t eclComputerReduce(EclPrimitives_t* prims, EclType_t type, EclOp_t op, EclBuffer_t* in, EclBuffer_t* out, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclComputerScan(EclPrimitives_t* prims, EclType_t type, EclOp_t op, bool exclusive, EclBuffer_t* in, EclBuffer_t* out, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclComputerSort(EclPrimitives_t* prims, EclBuffer_t* keys, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclComputerHistogram(EclPrimitives_t* prims, EclBuffer_t* in, size_t bins, EclBuffer_t* out, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclComputerCompact(EclPrimitives_t* prims, EclBuffer_t* in, EclBuffer_t* flags, EclBuffer_t* out, EclBuffer_t* count, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclPrimitivesClear(EclPrimitives_t* prims);
+
+typedef enum {
+    _ECL_PIPE_INPUT = 0, // item of buffer
+    _ECL_PIPE_SCALAR,
+    _ECL_PIPE_MAP, // expression over previous values, kept in private memory
+    _ECL_PIPE_OUTPUT // value stored to buffer
+} _EclPipeStageType_t;
+
+typedef struct {
+    _EclPipeStageType_t type;
+    char name[ECL_MAX_NAME_LEN];
+    char ctype[ECL_MAX_NAME_LEN]; // OpenCL C type, e.g. float4
+    char expr[ECL_MAX_STRING_LEN];
+    EclFrameArg_t arg;
+} _EclPipeStage_t;
+
+// elementwise stages fused into one generated kernel, intermediate values never reach global memory
+typedef struct {
+    EclProgramCache_t* cache; // generated program binaries are cached if set
+
+    _EclPipeStage_t _stages[ECL_MAX_ARRAY_SIZE];
+    size_t _stagesSize;
+
+    EclProgram_t _prog; // generated on first grid after change
+    EclKernel_t _kern;
+} EclPipeline_t;
+
+EclError_t eclPipelineInput(EclPipeline_t* pipe, const char* name, const char* type, EclBuffer_t* buf);
+EclError_t eclPipelineScalar(EclPipeline_t* pipe, const char* name, const char* type, void* value, size_t size);
+EclError_t eclPipelineMap(EclPipeline_t* pipe, const char* name, const char* type, const char* expr);
+EclError_t eclPipelineOutput(EclPipeline_t* pipe, const char* name, EclBuffer_t* buf);
+EclError_t eclPipelineGrid(EclPipeline_t* pipe, size_t count, const EclComputer_t* comp, EclComputerExec_t exec);
+EclError_t eclPipelineClear(EclPipeline_t* pipe);
+
+typedef struct {
+    void* user; // tag passed to watch
+    cl_int status; // CL_COMPLETE or negative error of command
+} EclCompletion_t;
+
+typedef struct {
+    atomic_size_t _seq; // position it may be written at, position + 1 when written
+    EclCompletion_t _val;
+} _EclCompletionSlot_t;
+
+// bounded lock-free ring, event callbacks push from driver threads, one thread polls
+typedef struct {
+    int fd; // eventfd, readable while completions are pending, e.g. for epoll
+
+    _EclCompletionSlot_t* _slots;
+    size_t _mask;
+    size_t _tail; // read by polling thread only
+
+    atomic_size_t _head;
+    atomic_size_t _inFlight; // watched, not polled yet, so push never finds ring full
+    atomic_size_t _watching; // callbacks not finished yet
+} EclCompletionQueue_t;
+
+EclError_t eclCompletionQueue(size_t capacity, EclCompletionQueue_t* out);
+EclError_t eclCompletionWatch(EclCompletionQueue_t* queue, const EclEvent_t* event, void* user);
+EclError_t eclCompletionPoll(EclCompletionQueue_t* queue, EclCompletion_t* out, size_t size, size_t* count);
+EclError_t eclCompletionQueueClear(EclCompletionQueue_t* queue);
+
+EclError_t eclProfilerCollect(EclProfiler_t* prof);
+EclError_t eclProfilerStats(EclProfiler_t* prof, EclProfileStats_t* out, size_t size, size_t* count);
+EclError_t eclProfilerExportTrace(EclProfiler_t* prof, const char* filename);
+EclError_t eclProfilerClear(EclProfiler_t* prof);
+
+EclError_t eclPoolStats(const EclPool_t* pool, EclPoolStats_t* out);
+EclError_t eclPoolClear(EclPool_t* pool);
+
+EclError_t eclEventAwait(const EclEvent_t* event);
+EclError_t eclEventsAwait(const EclEvent_t* events, size_t count);
+EclError_t eclEventClear(EclEvent_t* event);
+
 
 // additional wrappers
 #define out_of_memory_check(e, f)\
@@ -192,33 +837,98 @@ if(e == CL_OUT_OF_HOST_MEMORY || e == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_
 //           Implementation
 /////////////////////////////////////////
 
-EclError_t eclGetPlatformsCount(size_t* out) {
-    size_t count = 0;
+#ifdef ECL_THREAD_SAFE
+// every object guards own maps, locks are held only for lookups and inserts, never over driver calls
+_Thread_local char _eclThreadTag; // address identifies thread
+
+void _eclLock(_EclLock_t* lock) {
+    while(atomic_exchange_explicit(lock, 1, memory_order_acquire))
+        sched_yield();
+}
+
+void _eclUnlock(_EclLock_t* lock) {
+    atomic_store_explicit(lock, 0, memory_order_release);
+}
+
+uintptr_t _eclThread() {
+    return (uintptr_t)&_eclThreadTag;
+}
+#else
+void _eclLock(_EclLock_t* lock) {}
+void _eclUnlock(_EclLock_t* lock) {}
+
+uintptr_t _eclThread() {
+    return 0;
+}
+#endif
+
+// platforms and devices are discovered once per process
+_EclLock_t _eclRegistryLock;
+
+// platforms are listed once per process, devices of every type on first request
+_EclPlatformEntry_t* _eclPlatforms;
+size_t _eclPlatformsSize;
+
+EclError_t _eclLoadPlatforms() {
+    if(_eclPlatforms) return ECL_ERROR_OK;
+
+    cl_uint count = 0;
 
     cl_int err;
-    out_of_memory_check(err, clGetPlatformIDs(0, NULL, (cl_uint*)&count));
+    out_of_memory_check(err, clGetPlatformIDs(0, NULL, &count));
 
     if(count == 0) return ECL_ERROR_NO_PLATFORMS;
+    if(count > ECL_MAX_PLATFORMS_COUNT) count = ECL_MAX_PLATFORMS_COUNT;
+
+    cl_platform_id tmp[ECL_MAX_PLATFORMS_COUNT];
+    out_of_memory_check(err, clGetPlatformIDs(count, tmp, NULL));
+
+    _EclPlatformEntry_t* entries = (_EclPlatformEntry_t*)calloc(count, sizeof(_EclPlatformEntry_t));
+    if(!entries) return ECL_ERROR_OUT_OF_MEMORY;
+
+    for(size_t i = 0; i < count; i++)
+        entries[i]._id = tmp[i];
+
+    _eclPlatformsSize = count;
+    _eclPlatforms = entries;
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t _eclLoadPlatformInfo(_EclPlatformEntry_t* entry) {
+    if(entry->_info) return ECL_ERROR_OK;
+
+    cl_int err;
+    out_of_memory_check(err, clGetPlatformInfo(entry->_id, CL_PLATFORM_NAME, ECL_MAX_STRING_LEN * sizeof(char), entry->_name, NULL));
+    out_of_memory_check(err, clGetPlatformInfo(entry->_id, CL_PLATFORM_VERSION, ECL_MAX_STRING_LEN * sizeof(char), entry->_ocl_ver, NULL));
+    out_of_memory_check(err, clGetPlatformInfo(entry->_id, CL_PLATFORM_EXTENSIONS, ECL_MAX_STRING_LEN * sizeof(char), entry->_ext, NULL));
+
+    entry->_info = true;
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclGetPlatformsCount(size_t* out) {
+    _eclLock(&_eclRegistryLock);
+    EclError_t err = _eclLoadPlatforms();
+    size_t count = _eclPlatformsSize;
+    _eclUnlock(&_eclRegistryLock);
+
+    if(err != ECL_ERROR_OK) return err;
 
     *out = count;
     return ECL_ERROR_OK;
 }
 
-void _eclGetDevicesArrayByType(EclDeviceType_t type, EclPlatform_t* platform, EclDevice_t** out, size_t** outSize) {
+size_t _eclDeviceTypeIndex(EclDeviceType_t type) {
     switch(type) {
     case ECL_DEVICE_CPU:
-        if(out) *out = platform->cpu;
-        if(outSize) *outSize = &platform->cpuCount;
-        break;
+        return 0;
     case ECL_DEVICE_GPU:
-        if(out) *out = platform->gpu;
-        if(outSize) *outSize = &platform->gpuCount;
-        break;
+        return 1;
     case ECL_DEVICE_ACCEL:
-        if(out) *out = platform->accel;
-        if(outSize) *outSize = &platform->accelCount;
+        return 2;
     default:
-        break;
+        return 3;
     }
 }
 
@@ -229,6 +939,7 @@ EclError_t _eclGetDeviceByID(cl_device_id id, EclDevice_t* out) {
     out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_NAME, ECL_MAX_STRING_LEN * sizeof(char), out->name, NULL));
     out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_EXTENSIONS, ECL_MAX_STRING_LEN * sizeof(char), out->ext, NULL));
     out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_VERSION, ECL_MAX_STRING_LEN * sizeof(char), out->ocl_ver, NULL));
+    out_of_memory_check(err, clGetDeviceInfo(id, CL_DRIVER_VERSION, ECL_MAX_STRING_LEN * sizeof(char), out->drv_ver, NULL));
 
     out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &out->wrkgSize, NULL));
     out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS, sizeof(size_t), &out->wrki.dim, NULL));
@@ -236,294 +947,3630 @@ EclError_t _eclGetDeviceByID(cl_device_id id, EclDevice_t* out) {
 
     out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(size_t), &out->cu, NULL));
 
+    cl_ulong mem = 0;
+    out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &mem, NULL));
+    out->globalMem = mem;
+    out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(cl_ulong), &mem, NULL));
+    out->maxAlloc = mem;
+    out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &mem, NULL));
+    out->localMem = mem;
+
+    cl_uint value = 0;
+    out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE, sizeof(cl_uint), &value, NULL));
+    out->cacheLine = value;
+
+    cl_device_info widths[ECL_VEC_TYPES_COUNT] = {
+        CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR,
+        CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT,
+        CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT,
+        CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG,
+        CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT,
+        CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE,
+        CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF
+    };
+    for(size_t i = 0; i < ECL_VEC_TYPES_COUNT; i++) {
+        value = 0;
+        out_of_memory_check(err, clGetDeviceInfo(id, widths[i], sizeof(cl_uint), &value, NULL));
+        out->vecWidth[i] = err == CL_SUCCESS ? value : 0;
+    }
+
+    // only vendor extensions report simd width
+    value = 1;
+    if(strstr(out->ext, "cl_nv_device_attribute_query")) {
+        out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_WARP_SIZE_NV, sizeof(cl_uint), &value, NULL));
+    } else if(strstr(out->ext, "cl_amd_device_attribute_query")) {
+        out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_WAVEFRONT_WIDTH_AMD, sizeof(cl_uint), &value, NULL));
+    }
+    out->simd = value ? value : 1;
+
+    cl_bool unified = CL_FALSE;
+    out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &unified, NULL));
+    out->unified = unified || out->type == ECL_DEVICE_CPU;
+
+    // not supported before OpenCL 2.0
+    out->svm = 0;
+    out_of_memory_check(err, clGetDeviceInfo(id, CL_DEVICE_SVM_CAPABILITIES, sizeof(cl_device_svm_capabilities), &out->svm, NULL));
+    if(err != CL_SUCCESS) out->svm = 0;
+
     return ECL_ERROR_OK;
 }
 
-EclError_t _eclGetDevicesByType(EclDeviceType_t type, EclPlatform_t* platform) {
-    EclDevice_t* out = NULL;
-    size_t* outSize = NULL;
-    _eclGetDevicesArrayByType(type, platform, &out, &outSize);
+EclError_t _eclLoadDevices(_EclPlatformEntry_t* entry, EclDeviceType_t type) {
+    size_t t = _eclDeviceTypeIndex(type);
+    if(t > 2) return ECL_ERROR_NO_DEVICES;
+    if(entry->_loaded[t]) return ECL_ERROR_OK;
 
     // get devices count
-    size_t count = 0;
-    
+    cl_uint count = 0;
+
     cl_int err;
-    out_of_memory_check(err, clGetDeviceIDs(platform->_id, (cl_device_type)type, 0, NULL, (cl_uint*)&count));
+    out_of_memory_check(err, clGetDeviceIDs(entry->_id, (cl_device_type)type, 0, NULL, &count));
+    if(err != CL_SUCCESS) count = 0; // CL_DEVICE_NOT_FOUND
 
-    if(count == 0) return ECL_ERROR_NO_DEVICES;
+    if(count > ECL_MAX_DEVICES_COUNT) count = ECL_MAX_DEVICES_COUNT;
 
     // get devices id
     cl_device_id tmp[ECL_MAX_DEVICES_COUNT];
-    out_of_memory_check(err, clGetDeviceIDs(platform->_id, (cl_device_type)type, count, tmp, NULL));
+    if(count) {
+        out_of_memory_check(err, clGetDeviceIDs(entry->_id, (cl_device_type)type, count, tmp, NULL));
+    }
 
     // get devices
-    *outSize = count;
+    EclDevice_t* devices = count ? (EclDevice_t*)calloc(count, sizeof(EclDevice_t)) : NULL;
+    if(count && !devices) return ECL_ERROR_OUT_OF_MEMORY;
+
     for(size_t i = 0; i < count; i++) {
-        EclError_t e = _eclGetDeviceByID(tmp[i], &out[i]);
-        if(e != ECL_ERROR_OK) return e;
+        devices[i].type = type;
+
+        EclError_t e = _eclGetDeviceByID(tmp[i], &devices[i]);
+        if(e != ECL_ERROR_OK) {
+            free(devices);
+            return e;
+        }
     }
 
+    entry->_devices[t] = devices;
+    entry->_devicesSize[t] = count;
+    entry->_loaded[t] = true;
+
     return ECL_ERROR_OK;
 }
 
-EclError_t eclGetPlatform(size_t id, EclPlatform_t* out) {
-    // get platforms count
-    size_t count = 0;
+EclError_t _eclGetDevices(EclDeviceType_t type, const EclPlatform_t* platform, EclDevice_t** out, size_t* outSize) {
+    if(!platform || !platform->_entry) return ECL_ERROR_NO_PLATFORM;
 
-    EclError_t err = eclGetPlatformsCount(&count);
-    if(err != ECL_ERROR_OK) return err;
+    _eclLock(&_eclRegistryLock);
+    EclError_t err = _eclLoadDevices(platform->_entry, type);
+    _eclUnlock(&_eclRegistryLock);
 
-    if(id >= count) return ECL_ERROR_NO_PLATFORM;
+    if(err != ECL_ERROR_OK) return err;
 
-    // get platform id
-    cl_platform_id tmp[ECL_MAX_PLATFORMS_COUNT];
+    size_t t = _eclDeviceTypeIndex(type);
+    *out = platform->_entry->_devices[t];
+    *outSize = platform->_entry->_devicesSize[t];
 
-    cl_int tmpErr;
-    out_of_memory_check(tmpErr, clGetPlatformIDs(count, tmp, NULL));
+    return ECL_ERROR_OK;
+}
 
-    out->_id = tmp[id];
+EclError_t eclGetPlatform(size_t id, EclPlatform_t* out) {
+    _eclLock(&_eclRegistryLock);
+    EclError_t err = _eclLoadPlatforms();
+    if(err == ECL_ERROR_OK && id >= _eclPlatformsSize) err = ECL_ERROR_NO_PLATFORM;
+    if(err == ECL_ERROR_OK) err = _eclLoadPlatformInfo(&_eclPlatforms[id]);
+    _eclUnlock(&_eclRegistryLock);
 
-    // get platform name
-    out_of_memory_check(tmpErr, clGetPlatformInfo(out->_id, CL_PLATFORM_NAME, ECL_MAX_STRING_LEN * sizeof(char), out->name, NULL));
+    if(err != ECL_ERROR_OK) return err;
 
-    // get platform opencl version
-    out_of_memory_check(tmpErr, clGetPlatformInfo(out->_id, CL_PLATFORM_VERSION, ECL_MAX_STRING_LEN * sizeof(char), out->ocl_ver, NULL));
+    _EclPlatformEntry_t* entry = &_eclPlatforms[id];
 
-    // get platform extensions
-    out_of_memory_check(tmpErr, clGetPlatformInfo(out->_id, CL_PLATFORM_EXTENSIONS, ECL_MAX_STRING_LEN * sizeof(char), out->ext, NULL));
+    out->name = entry->_name;
+    out->ocl_ver = entry->_ocl_ver;
+    out->ext = entry->_ext;
+    out->_id = entry->_id;
+    out->_entry = entry;
 
-    // get platform devices
-    err = _eclGetDevicesByType(ECL_DEVICE_CPU, out);
-    if(err != ECL_ERROR_OK && err != ECL_ERROR_NO_DEVICES) return err;
+    return ECL_ERROR_OK;
+}
 
-    err = _eclGetDevicesByType(ECL_DEVICE_GPU, out);
-    if(err != ECL_ERROR_OK && err != ECL_ERROR_NO_DEVICES) return err;
+// host device, doesn't need platform
+EclDevice_t _eclHostDevice;
+
+EclDevice_t* _eclGetHostDevice() {
+    EclDevice_t* dev = &_eclHostDevice;
+
+    _eclLock(&_eclRegistryLock);
+    if(!dev->cu) {
+        long cu = sysconf(_SC_NPROCESSORS_ONLN);
+
+        strcpy(dev->name, "Host");
+        dev->type = ECL_DEVICE_HOST;
+        dev->unified = true;
+        dev->wrkgSize = 1 << 16;
+        dev->wrki.dim = 3;
+        for(size_t i = 0; i < 3; i++)
+            dev->wrki.sizes[i] = dev->wrkgSize;
+        dev->cu = cu > 0 ? (size_t)cu : 1;
+
+        long pages = sysconf(_SC_PHYS_PAGES);
+        long pageSize = sysconf(_SC_PAGESIZE);
+        dev->globalMem = pages > 0 && pageSize > 0 ? (size_t)pages * pageSize : 0;
+        dev->maxAlloc = dev->globalMem;
+
+        // host kernels are plain C, compiler vectorizes them
+        long line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+        dev->cacheLine = line > 0 ? (size_t)line : 64;
+        dev->simd = 1;
+        for(size_t i = 0; i < ECL_VEC_TYPES_COUNT; i++)
+            dev->vecWidth[i] = 1;
+    }
+    _eclUnlock(&_eclRegistryLock);
 
-    err = _eclGetDevicesByType(ECL_DEVICE_ACCEL, out);
-    if(err != ECL_ERROR_OK && err != ECL_ERROR_NO_DEVICES) return err;
+    return dev;
+}
 
-    return ECL_ERROR_OK;
+bool _eclIsHost(const EclComputer_t* comp) {
+    return comp->_host != NULL;
 }
 
-size_t eclGetDevicesCount(EclDeviceType_t type, EclPlatform_t* platform) {
-    size_t* count = NULL;
-    _eclGetDevicesArrayByType(type, platform, NULL, &count);
+void _eclHostRunGroup(_EclHostPool_t* pool, size_t g) {
+    EclWorkItem_t item = pool->_grid;
 
-    return *count;
-}
+    for(size_t d = 0; d < 3; d++) {
+        item.group[d] = g % pool->_groups[d];
+        g /= pool->_groups[d];
+    }
 
-EclError_t eclGetDevice(size_t id, EclDeviceType_t type, EclPlatform_t* platform, EclDevice_t** out) {
-    size_t* count = NULL;
-    EclDevice_t* devices = NULL;
-    _eclGetDevicesArrayByType(type, platform, &devices, &count);
+    // last group may be partial
+    size_t end[3];
+    for(size_t d = 0; d < 3; d++) {
+        size_t first = item.group[d] * item.localSize[d];
+        end[d] = item.globalSize[d] - first < item.localSize[d] ? item.globalSize[d] - first : item.localSize[d];
+    }
 
-    if(id >= *count) return ECL_ERROR_NO_DEVICE;
-    *out = &devices[id];
+    for(item.local[2] = 0; item.local[2] < end[2]; item.local[2]++) {
+        for(item.local[1] = 0; item.local[1] < end[1]; item.local[1]++) {
+            for(item.local[0] = 0; item.local[0] < end[0]; item.local[0]++) {
+                for(size_t d = 0; d < 3; d++)
+                    item.global[d] = item.offset[d] + item.group[d] * item.localSize[d] + item.local[d];
 
-    return ECL_ERROR_OK;
+                pool->_fn(&item, pool->_args);
+            }
+        }
+    }
 }
 
-EclError_t eclComputer(size_t devID, EclDeviceType_t type, EclPlatform_t* platform, EclComputer_t* out) {
-    // get device
-    EclDevice_t* dev = NULL;
+bool _eclHostPop(_EclHostQueue_t* q, size_t* out) {
+    pthread_mutex_lock(&q->_lock);
+    bool ok = q->_begin < q->_end;
+    if(ok) *out = q->_begin++;
+    pthread_mutex_unlock(&q->_lock);
 
-    EclError_t err = eclGetDevice(devID, type, platform, &dev);
-    if(err != ECL_ERROR_OK) return err;
+    return ok;
+}
 
-    out->dev = dev;
+bool _eclHostSteal(_EclHostPool_t* pool, size_t id) {
+    for(size_t i = 1; i < pool->_threadsSize; i++) {
+        _EclHostQueue_t* victim = &pool->_queues[(id + i) % pool->_threadsSize];
 
-    // create context and queue
+        pthread_mutex_lock(&victim->_lock);
+        size_t count = (victim->_end - victim->_begin + 1) / 2;
+        size_t end = victim->_end;
+        victim->_end -= count;
+        pthread_mutex_unlock(&victim->_lock);
+
+        if(count) {
+            _EclHostQueue_t* q = &pool->_queues[id];
+
+            pthread_mutex_lock(&q->_lock);
+            q->_begin = end - count;
+            q->_end = end;
+            pthread_mutex_unlock(&q->_lock);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// no work is added during grid, so thread is done when nothing is left to steal
+void _eclHostWork(_EclHostPool_t* pool, size_t id) {
+    size_t g = 0;
+    while(_eclHostPop(&pool->_queues[id], &g) || (_eclHostSteal(pool, id) && _eclHostPop(&pool->_queues[id], &g)))
+        _eclHostRunGroup(pool, g);
+}
+
+void* _eclHostThread(void* arg) {
+    _EclHostQueue_t* q = (_EclHostQueue_t*)arg;
+    _EclHostPool_t* pool = (_EclHostPool_t*)q->_pool;
+
+    size_t generation = 0;
+    while(true) {
+        pthread_mutex_lock(&pool->_lock);
+        while(!pool->_stop && pool->_generation == generation)
+            pthread_cond_wait(&pool->_start, &pool->_lock);
+
+        if(pool->_stop) {
+            pthread_mutex_unlock(&pool->_lock);
+            break;
+        }
+        generation = pool->_generation;
+        pthread_mutex_unlock(&pool->_lock);
+
+        _eclHostWork(pool, q->_id);
+
+        pthread_mutex_lock(&pool->_lock);
+        if(--pool->_running == 0) pthread_cond_signal(&pool->_done);
+        pthread_mutex_unlock(&pool->_lock);
+    }
+
+    return NULL;
+}
+
+void _eclHostPoolClear(_EclHostPool_t* pool) {
+    pthread_mutex_lock(&pool->_lock);
+    pool->_stop = true;
+    pthread_cond_broadcast(&pool->_start);
+    pthread_mutex_unlock(&pool->_lock);
+
+    for(size_t i = 1; i < pool->_threadsSize; i++) {
+        if(pool->_threads[i]) pthread_join(pool->_threads[i], NULL);
+    }
+
+    for(size_t i = 0; i < pool->_threadsSize; i++)
+        pthread_mutex_destroy(&pool->_queues[i]._lock);
+
+    pthread_mutex_destroy(&pool->_launch);
+    pthread_mutex_destroy(&pool->_lock);
+    pthread_cond_destroy(&pool->_start);
+    pthread_cond_destroy(&pool->_done);
+
+    free(pool->_threads);
+    free(pool->_queues);
+    free(pool);
+}
+
+EclError_t _eclHostPool(size_t threads, _EclHostPool_t** out) {
+    _EclHostPool_t* pool = (_EclHostPool_t*)calloc(1, sizeof(_EclHostPool_t));
+    if(!pool) return ECL_ERROR_OUT_OF_MEMORY;
+
+    pool->_threads = (pthread_t*)calloc(threads, sizeof(pthread_t));
+    pool->_queues = (_EclHostQueue_t*)calloc(threads, sizeof(_EclHostQueue_t));
+    if(!pool->_threads || !pool->_queues) {
+        free(pool->_threads);
+        free(pool->_queues);
+        free(pool);
+        return ECL_ERROR_OUT_OF_MEMORY;
+    }
+
+    pthread_mutex_init(&pool->_launch, NULL);
+    pthread_mutex_init(&pool->_lock, NULL);
+    pthread_cond_init(&pool->_start, NULL);
+    pthread_cond_init(&pool->_done, NULL);
+
+    pool->_threadsSize = threads;
+    for(size_t i = 0; i < threads; i++) {
+        pool->_queues[i]._pool = pool;
+        pool->_queues[i]._id = i;
+        pthread_mutex_init(&pool->_queues[i]._lock, NULL);
+    }
+
+    for(size_t i = 1; i < threads; i++) {
+        if(pthread_create(&pool->_threads[i], NULL, _eclHostThread, &pool->_queues[i]) != 0) {
+            _eclHostPoolClear(pool);
+            return ECL_ERROR_DEVICE_NOT_AVAILABLE;
+        }
+    }
+
+    *out = pool;
+    return ECL_ERROR_OK;
+}
+
+// host grid is synchronous, buffers are used in place
+EclError_t _eclHostGrid(EclFrame_t* frame, const size_t* offset, const EclWorkSize_t* global, const EclWorkSize_t* local, const EclComputer_t* comp, EclEvent_t* event) {
+    if(event) event->_ev = 0;
+
+    if(!frame->kern->host) return ECL_ERROR_NO_KERNEL;
+    if(global->dim == 0 || global->dim > 3 || local->dim > global->dim) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    void* args[ECL_MAX_ARRAY_SIZE];
+    for(size_t i = 0; i < frame->argsCount; i++) {
+        if(frame->args[i].type == ECL_ARG_BUFFER) args[i] = ((EclBuffer_t*)frame->args[i].arg)->data;
+        else if(frame->args[i].type == ECL_ARG_SVM) args[i] = ((EclSvm_t*)frame->args[i].arg)->data;
+        else if(frame->args[i].type == ECL_ARG_IMAGE) args[i] = ((EclImage_t*)frame->args[i].arg)->data;
+        else if(frame->args[i].type == ECL_ARG_LOCAL || frame->args[i].type == ECL_ARG_LOCAL_ITEMS) args[i] = NULL; // no local memory without barriers
+        else args[i] = frame->args[i].arg;
+    }
+
+    _EclHostPool_t* pool = comp->_host;
+    size_t threads = pool->_threadsSize;
+
+    EclWorkItem_t grid = {.dim = global->dim};
+    size_t groups[3];
+    size_t groupsCount = 1;
+
+    for(size_t d = 0; d < 3; d++) {
+        grid.globalSize[d] = d < global->dim ? global->sizes[d] : 1;
+        grid.offset[d] = offset && d < global->dim ? offset[d] : 0;
+
+        // without local size, first dimension is split into a few groups per thread
+        if(local->dim) grid.localSize[d] = d < local->dim && local->sizes[d] ? local->sizes[d] : 1;
+        else grid.localSize[d] = d == 0 ? grid.globalSize[0] / (16 * threads) : 1;
+        if(grid.localSize[d] == 0) grid.localSize[d] = 1;
+
+        groups[d] = (grid.globalSize[d] + grid.localSize[d] - 1) / grid.localSize[d];
+        groupsCount *= groups[d];
+    }
+    if(groupsCount == 0) return ECL_ERROR_OK;
+
+    pthread_mutex_lock(&pool->_launch);
+
+    pool->_fn = frame->kern->host;
+    pool->_args = args;
+    pool->_grid = grid;
+    memcpy(pool->_groups, groups, sizeof(groups));
+
+    for(size_t i = 0; i < threads; i++) {
+        _EclHostQueue_t* q = &pool->_queues[i];
+
+        pthread_mutex_lock(&q->_lock);
+        q->_begin = groupsCount * i / threads;
+        q->_end = groupsCount * (i + 1) / threads;
+        pthread_mutex_unlock(&q->_lock);
+    }
+
+    pthread_mutex_lock(&pool->_lock);
+    pool->_running = threads - 1;
+    pool->_generation++;
+    pthread_cond_broadcast(&pool->_start);
+    pthread_mutex_unlock(&pool->_lock);
+
+    _eclHostWork(pool, 0);
+
+    pthread_mutex_lock(&pool->_lock);
+    while(pool->_running)
+        pthread_cond_wait(&pool->_done, &pool->_lock);
+    pthread_mutex_unlock(&pool->_lock);
+
+    pthread_mutex_unlock(&pool->_launch);
+
+    return ECL_ERROR_OK;
+}
+
+size_t eclGetDevicesCount(EclDeviceType_t type, EclPlatform_t* platform) {
+    if(type == ECL_DEVICE_HOST) return 1;
+
+    EclDevice_t* devices = NULL;
+    size_t count = 0;
+    if(_eclGetDevices(type, platform, &devices, &count) != ECL_ERROR_OK) return 0;
+
+    return count;
+}
+
+EclError_t eclGetDevice(size_t id, EclDeviceType_t type, EclPlatform_t* platform, EclDevice_t** out) {
+    if(type == ECL_DEVICE_HOST) {
+        if(id != 0) return ECL_ERROR_NO_DEVICE;
+
+        *out = _eclGetHostDevice();
+        return ECL_ERROR_OK;
+    }
+
+    EclDevice_t* devices = NULL;
+    size_t count = 0;
+
+    EclError_t err = _eclGetDevices(type, platform, &devices, &count);
+    if(err == ECL_ERROR_NO_DEVICES) return ECL_ERROR_NO_DEVICE;
+    if(err != ECL_ERROR_OK) return err;
+
+    if(id >= count) return ECL_ERROR_NO_DEVICE;
+    *out = &devices[id];
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclComputer(size_t devID, EclDeviceType_t type, EclPlatform_t* platform, EclComputer_t* out) {
+    // get device
+    EclDevice_t* dev = NULL;
+
+    EclError_t err = eclGetDevice(devID, type, platform, &dev);
+    if(err != ECL_ERROR_OK) return err;
+
+    out->dev = dev;
+    out->_host = NULL;
+
+    if(type == ECL_DEVICE_HOST) return _eclHostPool(dev->cu, &out->_host);
+
+    // create context and queue
     cl_int tmpErr;
     out->_ctx = clCreateContext(NULL, 1, &out->dev->_id, NULL, NULL, &tmpErr);
     if(tmpErr == CL_DEVICE_NOT_AVAILABLE) return ECL_ERROR_DEVICE_NOT_AVAILABLE;
     if(tmpErr == CL_OUT_OF_HOST_MEMORY || tmpErr == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
 
-    out->_queue = clCreateCommandQueueWithProperties(out->_ctx, out->dev->_id, NULL, &tmpErr);
-    if(tmpErr == CL_OUT_OF_HOST_MEMORY || tmpErr == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    cl_queue_properties props[] = {CL_QUEUE_PROPERTIES, 0, 0};
+    if(out->queues == ECL_QUEUE_OUT_OF_ORDER) props[1] |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+    if(out->prof) props[1] |= CL_QUEUE_PROFILING_ENABLE;
+
+    out->_queue = clCreateCommandQueueWithProperties(out->_ctx, out->dev->_id, props, &tmpErr);
+    if(tmpErr == CL_OUT_OF_HOST_MEMORY || tmpErr == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+
+    out->_upload = out->_queue;
+    out->_download = out->_queue;
+
+    if(out->queues == ECL_QUEUE_SPLIT) {
+        out->_upload = clCreateCommandQueueWithProperties(out->_ctx, out->dev->_id, props, &tmpErr);
+        if(tmpErr == CL_OUT_OF_HOST_MEMORY || tmpErr == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+
+        out->_download = clCreateCommandQueueWithProperties(out->_ctx, out->dev->_id, props, &tmpErr);
+        if(tmpErr == CL_OUT_OF_HOST_MEMORY || tmpErr == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    }
+
+    return ECL_ERROR_OK;
+}
+
+uint64_t _eclHash(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for(size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= ECL_HASH_PRIME;
+    }
+    return hash;
+}
+
+uint64_t _eclHashString(uint64_t hash, const char* str) {
+    // hash with terminator, so ("ab", "c") and ("a", "bc") differ
+    return _eclHash(hash, str ? str : "", str ? strlen(str) + 1 : 1);
+}
+
+size_t _eclMapSlot(uint64_t key, size_t cap) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+
+    return (size_t)key & (cap - 1);
+}
+
+void* _eclMapFind(const _EclMap_t* map, uint64_t key) {
+    if(!map->_slotsCap) return NULL;
+
+    for(size_t i = _eclMapSlot(key, map->_slotsCap);; i = (i + 1) & (map->_slotsCap - 1)) {
+        size_t id = map->_slots[i];
+        if(!id) return NULL;
+
+        void* item = map->_items[id - 1];
+        if(*(const uint64_t*)item == key) return item;
+    }
+}
+
+// returns zeroed entry with key set, or NULL if out of memory
+void* _eclMapInsert(_EclMap_t* map, uint64_t key, size_t elemSize) {
+    // grow entries
+    if(map->_size == map->_cap) {
+        size_t cap = map->_cap ? 2 * map->_cap : 4;
+
+        void** tmp = (void**)realloc(map->_items, cap * sizeof(void*));
+        if(!tmp) return NULL;
+
+        map->_items = tmp;
+        map->_cap = cap;
+    }
+
+    // grow and rehash slots, load factor is kept under 1/2
+    if(2 * (map->_size + 1) > map->_slotsCap) {
+        size_t cap = map->_slotsCap ? 2 * map->_slotsCap : 8;
+
+        size_t* slots = (size_t*)calloc(cap, sizeof(size_t));
+        if(!slots) return NULL;
+
+        for(size_t id = 1; id <= map->_size; id++) {
+            size_t i = _eclMapSlot(*(const uint64_t*)map->_items[id - 1], cap);
+            while(slots[i]) i = (i + 1) & (cap - 1);
+            slots[i] = id;
+        }
+
+        free(map->_slots);
+        map->_slots = slots;
+        map->_slotsCap = cap;
+    }
+
+    void* item = calloc(1, elemSize);
+    if(!item) return NULL;
+    *(uint64_t*)item = key;
+
+    map->_items[map->_size++] = item;
+
+    size_t i = _eclMapSlot(key, map->_slotsCap);
+    while(map->_slots[i]) i = (i + 1) & (map->_slotsCap - 1);
+    map->_slots[i] = map->_size;
+
+    return item;
+}
+
+void _eclMapClear(_EclMap_t* map) {
+    for(size_t i = 0; i < map->_size; i++)
+        free(map->_items[i]);
+
+    free(map->_items);
+    free(map->_slots);
+    memset(map, 0, sizeof(_EclMap_t));
+}
+
+// i-th entry of map with inline first entry
+void* _eclMapAt(void* first, const _EclMap_t* map, size_t i) {
+    return i == 0 ? first : map->_items[i - 1];
+}
+
+void* _eclMapGet(void* first, size_t size, const _EclMap_t* map, uint64_t key) {
+    if(size && *(const uint64_t*)first == key) return first;
+    if(size < 2) return NULL;
+
+    return _eclMapFind(map, key);
+}
+
+void* _eclMapAdd(void* first, size_t* size, _EclMap_t* map, uint64_t key, size_t elemSize) {
+    void* item = first;
+
+    if(*size) item = _eclMapInsert(map, key, elemSize);
+    else {
+        memset(first, 0, elemSize);
+        *(uint64_t*)first = key;
+    }
+
+    if(item) (*size)++;
+    return item;
+}
+
+uint64_t _eclProgramKey(cl_context ctx, uint64_t opts) {
+    return _eclHash(opts, &ctx, sizeof(cl_context));
+}
+
+// entries are never moved, so they may be used after unlock
+_EclBufferMap_t* _eclGetBufferMap(EclBuffer_t* arg, const EclComputer_t* comp) {
+    _eclLock(&arg->_lock);
+    _EclBufferMap_t* e = (_EclBufferMap_t*)_eclMapGet(&arg->_buf, arg->_bufSize, &arg->_bufMap, (uintptr_t)comp->_ctx);
+    _eclUnlock(&arg->_lock);
+
+    return e;
+}
+
+bool _eclCheckBuffer(EclBuffer_t* arg, const EclComputer_t* comp, cl_mem* out) {
+    _EclBufferMap_t* e = _eclGetBufferMap(arg, comp);
+    if(!e) return false;
+
+    if(out) *out = e->_mem;
+    return true;
+}
+
+bool _eclCheckProgram(EclProgram_t* prog, const EclComputer_t* comp, uint64_t opts, cl_program* out) {
+    _eclLock(&prog->_lock);
+    _EclProgramMap_t* e = (_EclProgramMap_t*)_eclMapGet(&prog->_prog, prog->_progSize, &prog->_progMap, _eclProgramKey(comp->_ctx, opts));
+    _eclUnlock(&prog->_lock);
+
+    if(!e) return false;
+
+    if(out) *out = e->_prog;
+    return true;
+}
+
+// kernel args are set on every launch, so in thread-safe mode every thread has its own kernel
+uint64_t _eclKernelKey(cl_program prog, size_t width) {
+    uint64_t key = (uintptr_t)prog;
+    if(width > 1) key = _eclHash(key, &width, sizeof(size_t)); // vector variant
+
+#ifdef ECL_THREAD_SAFE
+    uintptr_t self = _eclThread();
+    return _eclHash(key, &self, sizeof(uintptr_t));
+#else
+    return key;
+#endif
+}
+
+bool _eclCheckKernel(EclKernel_t* kern, cl_program prog, size_t width, cl_kernel* out) {
+    _eclLock(&kern->_lock);
+    _EclKernelMap_t* e = (_EclKernelMap_t*)_eclMapGet(&kern->_kern, kern->_kernSize, &kern->_kernMap, _eclKernelKey(prog, width));
+    _eclUnlock(&kern->_lock);
+
+    if(!e || !e->_kern) return false;
+
+    if(out) *out = e->_kern;
+    return true;
+}
+
+size_t _eclPoolClass(size_t size) {
+    size_t c = 0;
+    while(c < ECL_POOL_CLASSES && ((size_t)ECL_POOL_MIN_CLASS << c) < size) c++;
+
+    return c;
+}
+
+// reserves region of class c under pool lock, slab is 0 if new slab is needed
+EclError_t _eclPoolReserve(EclPool_t* pool, size_t c, size_t size, cl_mem_flags flags, _EclPoolRegion_t* outFree, cl_mem* outSlab, size_t* outOrigin) {
+    size_t classSize = (size_t)ECL_POOL_MIN_CLASS << c;
+
+    // reuse free region of the same access, latest first
+    _EclPoolFreeList_t* list = &pool->_free[c];
+    size_t i = list->_size;
+    while(i && list->_regions[i - 1]._flags != flags) i--;
+
+    if(i) {
+        *outFree = list->_regions[i - 1];
+        list->_regions[i - 1] = list->_regions[--list->_size];
+
+        pool->_hits++;
+        pool->_allocated += classSize;
+        pool->_inUse += size;
+
+        return ECL_ERROR_OK;
+    }
+
+    // carve new region
+    for(size_t i = 0; i < pool->_slabsSize; i++) {
+        _EclPoolSlab_t* slab = &pool->_slabs[i];
+
+        size_t origin = (slab->_used + pool->_align - 1) / pool->_align * pool->_align;
+        if(origin + classSize <= slab->_size) {
+            slab->_used = origin + classSize;
+
+            *outSlab = slab->_mem;
+            *outOrigin = origin;
+
+            pool->_misses++;
+            pool->_allocated += classSize;
+            pool->_inUse += size;
+
+            return ECL_ERROR_OK;
+        }
+    }
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t _eclPoolAddSlab(EclPool_t* pool, cl_mem mem) {
+    if(pool->_slabsSize == pool->_slabsCap) {
+        size_t cap = pool->_slabsCap ? 2 * pool->_slabsCap : 4;
+
+        _EclPoolSlab_t* tmp = (_EclPoolSlab_t*)realloc(pool->_slabs, cap * sizeof(_EclPoolSlab_t));
+        if(!tmp) return ECL_ERROR_OUT_OF_MEMORY;
+
+        pool->_slabs = tmp;
+        pool->_slabsCap = cap;
+    }
+
+    _EclPoolSlab_t* slab = &pool->_slabs[pool->_slabsSize++];
+    slab->_mem = mem;
+    slab->_size = pool->slabSize;
+    slab->_used = 0;
+
+    return ECL_ERROR_OK;
+}
+
+// reused region comes with event of its last command, caller owns it
+EclError_t _eclPoolAlloc(EclPool_t* pool, const EclComputer_t* comp, size_t size, cl_mem_flags flags, cl_mem* out, size_t* outClass, cl_event* outEv) {
+    // pool is bound to the first context
+    cl_uint alignBits = 0;
+    if(!pool->_ctx) {
+        cl_int err;
+        out_of_memory_check(err, clGetDeviceInfo(comp->dev->_id, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(cl_uint), &alignBits, NULL));
+    }
+
+    _eclLock(&pool->_lock);
+    if(!pool->_ctx) {
+        pool->_ctx = comp->_ctx;
+        pool->_align = alignBits > 8 ? alignBits / 8 : 1;
+        if(!pool->slabSize) pool->slabSize = ECL_POOL_SLAB_SIZE;
+    }
+    size_t slabSize = pool->slabSize;
+    bool other = pool->_ctx != comp->_ctx;
+    _eclUnlock(&pool->_lock);
+
+    if(other) return ECL_ERROR_ALLOCATE_BUFFER;
+
+    size_t c = _eclPoolClass(size);
+    if(c >= ECL_POOL_CLASSES) return ECL_ERROR_ALLOCATE_BUFFER;
+
+    size_t classSize = (size_t)ECL_POOL_MIN_CLASS << c;
+    if(classSize > slabSize) return ECL_ERROR_ALLOCATE_BUFFER;
+
+    _EclPoolRegion_t region = {};
+    cl_mem slab = 0;
+    size_t origin = 0;
+
+    _eclLock(&pool->_lock);
+    _eclPoolReserve(pool, c, size, flags, &region, &slab, &origin);
+    _eclUnlock(&pool->_lock);
+
+    cl_mem mem = region._mem;
+
+    cl_int err;
+
+    // slab is created without lock, region is reserved once it is added
+    if(!mem && !slab) {
+        cl_mem newSlab = clCreateBuffer(comp->_ctx, CL_MEM_READ_WRITE, slabSize, NULL, &err);
+        if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+        if(err != CL_SUCCESS) return ECL_ERROR_ALLOCATE_BUFFER;
+
+        _eclLock(&pool->_lock);
+        EclError_t tmpErr = _eclPoolAddSlab(pool, newSlab);
+        if(tmpErr == ECL_ERROR_OK) _eclPoolReserve(pool, c, size, flags, &region, &slab, &origin);
+        mem = region._mem;
+        _eclUnlock(&pool->_lock);
+
+        if(tmpErr != ECL_ERROR_OK) {
+            clReleaseMemObject(newSlab);
+            return tmpErr;
+        }
+    }
+
+    // region of failed sub-buffer stays reserved until pool is cleared
+    if(!mem) {
+        cl_buffer_region bounds = {.origin = origin, .size = classSize};
+        mem = clCreateSubBuffer(slab, flags, CL_BUFFER_CREATE_TYPE_REGION, &bounds, &err);
+        if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+        if(err != CL_SUCCESS) return ECL_ERROR_ALLOCATE_BUFFER;
+    }
+
+    *out = mem;
+    *outClass = c;
+    *outEv = region._ev;
+
+    return ECL_ERROR_OK;
+}
+
+// called under pool lock, region keeps event of its last command
+EclError_t _eclPoolFree(EclPool_t* pool, cl_mem mem, size_t c, size_t size, cl_mem_flags flags, cl_event ev) {
+    _EclPoolFreeList_t* list = &pool->_free[c];
+
+    if(list->_size == list->_cap) {
+        size_t cap = list->_cap ? 2 * list->_cap : 16;
+
+        _EclPoolRegion_t* tmp = (_EclPoolRegion_t*)realloc(list->_regions, cap * sizeof(_EclPoolRegion_t));
+        if(!tmp) return ECL_ERROR_OUT_OF_MEMORY;
+
+        list->_regions = tmp;
+        list->_cap = cap;
+    }
+    list->_regions[list->_size++] = (_EclPoolRegion_t){._mem = mem, ._flags = flags, ._ev = ev};
+
+    pool->_allocated -= (size_t)ECL_POOL_MIN_CLASS << c;
+    pool->_inUse -= size;
+
+    return ECL_ERROR_OK;
+}
+
+// only one context may own host memory, called under buffer lock
+bool _eclBufferOwner(EclBuffer_t* arg) {
+    for(size_t i = 0; i < arg->_bufSize; i++) {
+        if(((_EclBufferMap_t*)_eclMapAt(&arg->_buf, &arg->_bufMap, i))->_zero) return false;
+    }
+
+    return true;
+}
+
+EclError_t _eclCreateBuffer(EclBuffer_t* arg, const EclComputer_t* comp, cl_mem* out) {
+    // host uses buffer data directly
+    if(_eclIsHost(comp)) {
+        *out = 0;
+        return ECL_ERROR_OK;
+    }
+
+    // check buffer
+    if(_eclCheckBuffer(arg, comp, out)) return ECL_ERROR_OK;
+
+    _eclLock(&arg->_lock);
+    bool owner = _eclBufferOwner(arg);
+    _eclUnlock(&arg->_lock);
+
+    cl_mem_flags flags = (cl_mem_flags)arg->access;
+    void* host = NULL;
+    bool zero = false;
+
+    if(arg->memory == ECL_BUFFER_HOST && comp->dev->unified && owner && arg->data) {
+        flags |= CL_MEM_USE_HOST_PTR;
+        host = arg->data;
+        zero = true;
+    } else if(arg->memory == ECL_BUFFER_PINNED) {
+        flags |= CL_MEM_ALLOC_HOST_PTR;
+        zero = owner && !arg->data;
+    }
+
+    // create buffer without lock, device memory is taken from pool if possible
+    cl_mem mem = 0;
+    EclPool_t* pool = NULL;
+    size_t c = 0;
+    cl_event ev = 0; // last command on reused pool region
+
+    if(comp->pool && arg->memory == ECL_BUFFER_DEVICE) {
+        EclError_t tmpErr = _eclPoolAlloc(comp->pool, comp, arg->size, flags, &mem, &c, &ev);
+        if(tmpErr == ECL_ERROR_OUT_OF_MEMORY) return tmpErr;
+
+        if(tmpErr == ECL_ERROR_OK) pool = comp->pool;
+    }
+
+    if(!pool) {
+        cl_int err;
+        mem = clCreateBuffer(comp->_ctx, flags, arg->size, host, &err);
+
+        if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+        if(err != CL_SUCCESS) return ECL_ERROR_ALLOCATE_BUFFER;
+    }
+
+    // other thread may create buffer for the same context meanwhile
+    _eclLock(&arg->_lock);
+    _EclBufferMap_t* e = (_EclBufferMap_t*)_eclMapGet(&arg->_buf, arg->_bufSize, &arg->_bufMap, (uintptr_t)comp->_ctx);
+    bool added = !e && (!zero || _eclBufferOwner(arg));
+
+    if(added) {
+        e = (_EclBufferMap_t*)_eclMapAdd(&arg->_buf, &arg->_bufSize, &arg->_bufMap, (uintptr_t)comp->_ctx, sizeof(_EclBufferMap_t));
+        if(e) {
+            e->_ctx = comp->_ctx;
+            e->_mem = mem;
+            e->_zero = zero;
+            e->_ptr = host;
+            e->_pool = pool;
+            e->_class = c;
+            e->_size = pool ? arg->size : 0;
+            e->_ev = ev; // first command waits for previous owner of region
+        }
+    }
+    _eclUnlock(&arg->_lock);
+
+    if(!added || !e) {
+        if(pool) {
+            _eclLock(&pool->_lock);
+            _eclPoolFree(pool, mem, c, arg->size, flags, ev);
+            _eclUnlock(&pool->_lock);
+        } else
+            clReleaseMemObject(mem);
+
+        if(added) return ECL_ERROR_OUT_OF_MEMORY;
+
+        // host memory got other owner, buffer is created again without it
+        if(!e) return _eclCreateBuffer(arg, comp, out);
+    }
+
+    *out = e->_mem;
+    return ECL_ERROR_OK;
+}
+
+_EclBufferMap_t* _eclGetImageMap(EclImage_t* img, const EclComputer_t* comp) {
+    _eclLock(&img->_lock);
+    _EclBufferMap_t* e = (_EclBufferMap_t*)_eclMapGet(&img->_img, img->_imgSize, &img->_imgMap, (uintptr_t)comp->_ctx);
+    _eclUnlock(&img->_lock);
+
+    return e;
+}
+
+EclError_t _eclCreateImage(EclImage_t* img, const EclComputer_t* comp, cl_mem* out) {
+    _EclBufferMap_t* e = _eclGetImageMap(img, comp);
+    if(e) {
+        *out = e->_mem;
+        return ECL_ERROR_OK;
+    }
+
+    cl_image_format format = {.image_channel_order = img->format.channels, .image_channel_data_type = img->format.type};
+    cl_image_desc desc = {
+        .image_type = img->depth > 1 ? CL_MEM_OBJECT_IMAGE3D : CL_MEM_OBJECT_IMAGE2D,
+        .image_width = img->width,
+        .image_height = img->height,
+        .image_depth = img->depth > 1 ? img->depth : 1
+    };
+
+    cl_int err;
+    cl_mem mem = clCreateImage(comp->_ctx, (cl_mem_flags)img->access, &format, &desc, NULL, &err);
+    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    if(err == CL_IMAGE_FORMAT_NOT_SUPPORTED || err == CL_INVALID_IMAGE_FORMAT_DESCRIPTOR) return ECL_ERROR_INVALID_IMAGE_FORMAT;
+    if(err == CL_INVALID_IMAGE_SIZE) return ECL_ERROR_INVALID_ARG_SIZE;
+    if(err != CL_SUCCESS) return ECL_ERROR_ALLOCATE_BUFFER;
+
+    // image is created without lock, other thread may create it meanwhile
+    _eclLock(&img->_lock);
+    e = (_EclBufferMap_t*)_eclMapGet(&img->_img, img->_imgSize, &img->_imgMap, (uintptr_t)comp->_ctx);
+    bool added = !e;
+    if(added) {
+        e = (_EclBufferMap_t*)_eclMapAdd(&img->_img, &img->_imgSize, &img->_imgMap, (uintptr_t)comp->_ctx, sizeof(_EclBufferMap_t));
+        if(e) {
+            e->_ctx = comp->_ctx;
+            e->_mem = mem;
+        }
+    }
+    _eclUnlock(&img->_lock);
+
+    if(!added || !e) clReleaseMemObject(mem);
+    if(!e) return ECL_ERROR_OUT_OF_MEMORY;
+
+    *out = e->_mem;
+    return ECL_ERROR_OK;
+}
+
+_EclSamplerMap_t* _eclGetSamplerMap(EclSampler_t* sampler, const EclComputer_t* comp) {
+    _eclLock(&sampler->_lock);
+    _EclSamplerMap_t* e = (_EclSamplerMap_t*)_eclMapGet(&sampler->_sampler, sampler->_samplerSize, &sampler->_samplerMap, (uintptr_t)comp->_ctx);
+    _eclUnlock(&sampler->_lock);
+
+    return e;
+}
+
+EclError_t _eclCreateSampler(EclSampler_t* sampler, const EclComputer_t* comp, cl_sampler* out) {
+    _EclSamplerMap_t* e = _eclGetSamplerMap(sampler, comp);
+    if(e) {
+        *out = e->_sampler;
+        return ECL_ERROR_OK;
+    }
+
+    cl_sampler_properties props[] = {
+        CL_SAMPLER_NORMALIZED_COORDS, sampler->normalized ? CL_TRUE : CL_FALSE,
+        CL_SAMPLER_ADDRESSING_MODE, sampler->address ? (cl_sampler_properties)sampler->address : CL_ADDRESS_CLAMP_TO_EDGE,
+        CL_SAMPLER_FILTER_MODE, sampler->filter ? (cl_sampler_properties)sampler->filter : CL_FILTER_NEAREST,
+        0
+    };
+
+    cl_int err;
+    cl_sampler tmp = clCreateSamplerWithProperties(comp->_ctx, props, &err);
+    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    if(err != CL_SUCCESS) return ECL_ERROR_INVALID_IMAGE_FORMAT;
+
+    // sampler is created without lock, other thread may create it meanwhile
+    _eclLock(&sampler->_lock);
+    e = (_EclSamplerMap_t*)_eclMapGet(&sampler->_sampler, sampler->_samplerSize, &sampler->_samplerMap, (uintptr_t)comp->_ctx);
+    bool added = !e;
+    if(added) {
+        e = (_EclSamplerMap_t*)_eclMapAdd(&sampler->_sampler, &sampler->_samplerSize, &sampler->_samplerMap, (uintptr_t)comp->_ctx, sizeof(_EclSamplerMap_t));
+        if(e) e->_sampler = tmp;
+    }
+    _eclUnlock(&sampler->_lock);
+
+    if(!added || !e) clReleaseSampler(tmp);
+    if(!e) return ECL_ERROR_OUT_OF_MEMORY;
+
+    *out = e->_sampler;
+    return ECL_ERROR_OK;
+}
+
+typedef struct {
+    char magic[4];
+    uint64_t key;
+    uint64_t size;
+} _EclProgramBinaryHeader_t;
+
+uint64_t _eclProgramCacheKey(const EclProgram_t* prog, const EclDevice_t* dev, const char* options) {
+    uint64_t key = _eclHashString(ECL_HASH_SEED, prog->src);
+    key = _eclHashString(key, dev->name);
+    key = _eclHashString(key, dev->ocl_ver);
+    key = _eclHashString(key, dev->drv_ver);
+    key = _eclHashString(key, options);
+
+    return key;
+}
+
+void _eclProgramCachePath(const EclProgramCache_t* cache, uint64_t key, char* out, size_t size) {
+    snprintf(out, size, "%s/%016llx.bin", cache->dir, (unsigned long long)key);
+}
+
+// unique temporary file next to path, renamed over it once written
+FILE* _eclOpenTemp(const char* path, char* tmpPath, size_t size, const char* mode) {
+    snprintf(tmpPath, size, "%s.XXXXXX", path);
+
+    int fd = mkstemp(tmpPath);
+    if(fd < 0) return NULL;
+
+    // mkstemp creates private file, keep usual permissions of the result
+    fchmod(fd, 0644);
+
+    FILE* f = fdopen(fd, mode);
+    if(!f) {
+        close(fd);
+        remove(tmpPath);
+    }
+
+    return f;
+}
+
+EclError_t _eclLoadProgramBinary(const EclProgramCache_t* cache, uint64_t key, const EclComputer_t* comp, const char* options, cl_program* out) {
+    char path[ECL_MAX_STRING_LEN + 32];
+    _eclProgramCachePath(cache, key, path, sizeof(path));
+
+    FILE* f = fopen(path, "rb");
+    if(!f) return ECL_ERROR_LOAD_PROGRAM;
+
+    // check header, size must match the file so truncated or corrupted entry isn't allocated
+    struct stat st;
+    _EclProgramBinaryHeader_t header = {};
+    if(fstat(fileno(f), &st) != 0 || fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "ECLB", 4) != 0 || header.key != key || header.size == 0 ||
+       (uint64_t)st.st_size != sizeof(header) + (uint64_t)header.size) {
+        fclose(f);
+        return ECL_ERROR_LOAD_PROGRAM;
+    }
+
+    // read binary
+    unsigned char* bin = (unsigned char*)malloc(header.size);
+    if(!bin) {
+        fclose(f);
+        return ECL_ERROR_OUT_OF_MEMORY;
+    }
+
+    size_t binSize = header.size;
+    size_t readSize = fread(bin, 1, binSize, f);
+    fclose(f);
+
+    if(readSize != binSize) {
+        free(bin);
+        return ECL_ERROR_LOAD_PROGRAM;
+    }
+
+    // create and build program from binary
+    cl_int status = 0;
+    cl_int err = 0;
+    const unsigned char* tmp = bin;
+    cl_program prog = clCreateProgramWithBinary(comp->_ctx, 1, &comp->dev->_id, &binSize, &tmp, &status, &err);
+    free(bin);
+
+    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    if(err != CL_SUCCESS || status != CL_SUCCESS) {
+        if(prog) clReleaseProgram(prog);
+        return ECL_ERROR_LOAD_PROGRAM;
+    }
+
+    err = clBuildProgram(prog, 0, NULL, options, NULL, NULL);
+    if(err != CL_SUCCESS) {
+        clReleaseProgram(prog);
+        return ECL_ERROR_LOAD_PROGRAM;
+    }
+
+    *out = prog;
+    return ECL_ERROR_OK;
+}
+
+EclError_t _eclStoreProgramBinary(const EclProgramCache_t* cache, uint64_t key, cl_program prog) {
+    // get binary (program is built for a single device)
+    size_t binSize = 0;
+
+    cl_int err;
+    out_of_memory_check(err, clGetProgramInfo(prog, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binSize, NULL));
+    if(err != CL_SUCCESS || binSize == 0) return ECL_ERROR_LOAD_PROGRAM;
+
+    unsigned char* bin = (unsigned char*)malloc(binSize);
+    if(!bin) return ECL_ERROR_OUT_OF_MEMORY;
+
+    err = clGetProgramInfo(prog, CL_PROGRAM_BINARIES, sizeof(unsigned char*), &bin, NULL);
+    if(err != CL_SUCCESS) {
+        free(bin);
+        return ECL_ERROR_LOAD_PROGRAM;
+    }
+
+    // write to temporary file and rename, so concurrent readers never see partial binaries
+    char path[ECL_MAX_STRING_LEN + 32];
+    char tmpPath[ECL_MAX_STRING_LEN + 64];
+    _eclProgramCachePath(cache, key, path, sizeof(path));
+
+    mkdir(cache->dir, 0755);
+
+    FILE* f = _eclOpenTemp(path, tmpPath, sizeof(tmpPath), "wb");
+    if(!f) {
+        free(bin);
+        return ECL_ERROR_LOAD_PROGRAM;
+    }
+
+    _EclProgramBinaryHeader_t header = {.magic = {'E', 'C', 'L', 'B'}, .key = key, .size = binSize};
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(bin, 1, binSize, f) == binSize;
+    ok = (fclose(f) == 0) && ok;
+    free(bin);
+
+    if(!ok || rename(tmpPath, path) != 0) {
+        remove(tmpPath);
+        return ECL_ERROR_LOAD_PROGRAM;
+    }
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t _eclBuildProgram(EclProgram_t* prog, const EclComputer_t* comp, const char* options, cl_program* out) {
+    // try cached binary
+    uint64_t key = 0;
+    if(prog->cache) {
+        key = _eclProgramCacheKey(prog, comp->dev, options);
+
+        // any load failure is a miss, program is built from source then
+        EclError_t tmpErr = _eclLoadProgramBinary(prog->cache, key, comp, options, out);
+
+        _eclLock(&prog->cache->_lock);
+        if(tmpErr == ECL_ERROR_OK) prog->cache->hits++;
+        else prog->cache->misses++;
+        _eclUnlock(&prog->cache->_lock);
+
+        if(tmpErr == ECL_ERROR_OK) return ECL_ERROR_OK;
+    }
+
+    // build from source
+    const char* src = prog->src;
+    size_t srcLen = strlen(prog->src);
+
+    cl_int err = 0;
+    *out = clCreateProgramWithSource(comp->_ctx, 1, &src, &srcLen, &err);
+
+    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    if(err != CL_SUCCESS) return ECL_ERROR_CREATE_PROGRAM;
+
+    // unbuilt program is never stored to cache
+    err = clBuildProgram(*out, 0, NULL, options, NULL, NULL);
+    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    if(err == CL_COMPILER_NOT_AVAILABLE) return ECL_ERROR_NO_COMPILER;
+    if(err == CL_INVALID_BUILD_OPTIONS) return ECL_ERROR_INVALID_OPTIONS;
+    if(err != CL_SUCCESS) return ECL_ERROR_BUILD_PROGRAM;
+
+    // store binary, failure only costs a rebuild next time
+    if(prog->cache) {
+        EclError_t tmpErr = _eclStoreProgramBinary(prog->cache, key, *out);
+        if(tmpErr == ECL_ERROR_OUT_OF_MEMORY) return tmpErr;
+    }
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t _eclCreateProgram(EclProgram_t* prog, const EclComputer_t* comp, const char* options, cl_program* out) {
+    // check program
+    uint64_t opts = _eclHashString(ECL_HASH_SEED, options);
+    if(_eclCheckProgram(prog, comp, opts, out)) return ECL_ERROR_OK;
+
+    // build without lock, other thread may build the same program meanwhile
+    cl_program tmp = 0;
+    EclError_t err = _eclBuildProgram(prog, comp, options, &tmp);
+    if(err != ECL_ERROR_OK) {
+        if(tmp) clReleaseProgram(tmp);
+        return err;
+    }
+
+    uint64_t key = _eclProgramKey(comp->_ctx, opts);
+
+    _eclLock(&prog->_lock);
+    _EclProgramMap_t* e = (_EclProgramMap_t*)_eclMapGet(&prog->_prog, prog->_progSize, &prog->_progMap, key);
+    bool added = !e;
+    if(added) {
+        e = (_EclProgramMap_t*)_eclMapAdd(&prog->_prog, &prog->_progSize, &prog->_progMap, key, sizeof(_EclProgramMap_t));
+        if(e) {
+            e->_ctx = comp->_ctx;
+            e->_opts = opts;
+            e->_prog = tmp;
+        }
+    }
+    _eclUnlock(&prog->_lock);
+
+    if(!added || !e) clReleaseProgram(tmp);
+    if(!e) return ECL_ERROR_OUT_OF_MEMORY;
+
+    *out = e->_prog;
+    return ECL_ERROR_OK;
+}
+
+// kernel name of vector variant, width 1 is scalar kernel
+void _eclKernelName(const EclKernel_t* kern, size_t width, char* out, size_t size) {
+    if(width > 1) snprintf(out, size, "%s%zu", kern->name, width);
+    else snprintf(out, size, "%s", kern->name);
+}
+
+// widest variant not wider than device preferred width, which keeps grid, offset and work-groups whole
+size_t _eclKernelWidth(const EclKernel_t* kern, const EclDevice_t* dev, const size_t* offset, const EclWorkSize_t* global, const EclWorkSize_t* local) {
+    size_t best = 1;
+    if(global->dim == 0) return best;
+
+    for(size_t i = 0; i < ECL_MAX_VEC_VARIANTS; i++) {
+        size_t w = kern->vec[i];
+        if(w <= best || w > dev->vecWidth[kern->vecType]) continue;
+
+        if(global->sizes[0] % w || (offset && offset[0] % w)) continue;
+        if(local->dim && local->sizes[0] && (global->sizes[0] / w) % local->sizes[0]) continue;
+
+        best = w;
+    }
+
+    return best;
+}
+
+EclError_t _eclCreateKernel(EclKernel_t* kern, cl_program prog, size_t width, cl_kernel* out) {
+    // check kernel
+    if(_eclCheckKernel(kern, prog, width, out)) return ECL_ERROR_OK;
+
+    // create kernel, entry released by its thread is reused
+    uint64_t key = _eclKernelKey(prog, width);
+
+    _eclLock(&kern->_lock);
+    _EclKernelMap_t* e = (_EclKernelMap_t*)_eclMapGet(&kern->_kern, kern->_kernSize, &kern->_kernMap, key);
+    if(!e) e = (_EclKernelMap_t*)_eclMapAdd(&kern->_kern, &kern->_kernSize, &kern->_kernMap, key, sizeof(_EclKernelMap_t));
+    if(e) e->_thread = _eclThread();
+    _eclUnlock(&kern->_lock);
+
+    if(!e) return ECL_ERROR_OUT_OF_MEMORY;
+
+    char name[ECL_MAX_STRING_LEN + 32];
+    _eclKernelName(kern, width, name, sizeof(name));
+
+    cl_int err = 0;
+
+    e->_prog = prog;
+    e->_kern = clCreateKernel(prog, name, &err);
+
+    *out = e->_kern;
+
+    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    if(err == CL_INVALID_KERNEL_NAME) return ECL_ERROR_NO_KERNEL; 
+
+    return ECL_ERROR_OK;
+}
+
+typedef struct {
+    cl_event list[2 * ECL_MAX_ARRAY_SIZE];
+    cl_uint size;
+} _EclWaitList_t;
+
+EclError_t _eclWaitList(const EclEvent_t* wait, size_t waitCount, _EclWaitList_t* out) {
+    if(waitCount > ECL_MAX_ARRAY_SIZE) return ECL_ERROR_INVALID_EVENTS;
+
+    out->size = 0;
+    for(size_t i = 0; i < waitCount; i++) {
+        if(wait[i]._ev) out->list[out->size++] = wait[i]._ev;
+    }
+
+    return ECL_ERROR_OK;
+}
+
+void _eclWaitListAdd(_EclWaitList_t* list, cl_event ev) {
+    if(ev) list->list[list->size++] = ev;
+}
+
+// commands on different queues (or out-of-order queue) are ordered by buffers events
+bool _eclTracked(const EclComputer_t* comp) {
+    return comp->queues != ECL_QUEUE_SINGLE;
+}
+
+void _eclTrackEvent(_EclBufferMap_t* e, cl_event ev) {
+    if(ev) clRetainEvent(ev);
+
+    _eclLock(&e->_evLock);
+    cl_event old = e->_ev;
+    e->_ev = ev;
+    _eclUnlock(&e->_evLock);
+
+    if(old) clReleaseEvent(old);
+}
+
+// command event is needed by user, other queues or profiler
+bool _eclNeedEvent(const EclComputer_t* comp, const EclEvent_t* event) {
+    return event || _eclTracked(comp) || comp->prof;
+}
+
+// reads times of finished command and releases its event, returns false while command runs
+bool _eclProfileCollect(EclProfileRecord_t* r, bool drop) {
+    if(!r->_ev) return true;
+
+    cl_int status = CL_COMPLETE;
+    clGetEventInfo(r->_ev, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, NULL);
+    if(status > CL_COMPLETE && !drop) return false;
+
+    // failed and dropped commands keep zero time
+    if(status == CL_COMPLETE) {
+        clGetEventProfilingInfo(r->_ev, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &r->queued, NULL);
+        clGetEventProfilingInfo(r->_ev, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &r->submit, NULL);
+        clGetEventProfilingInfo(r->_ev, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &r->start, NULL);
+        clGetEventProfilingInfo(r->_ev, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &r->end, NULL);
+    }
+
+    clReleaseEvent(r->_ev);
+    r->_ev = 0;
+
+    return true;
+}
+
+// collects records in order until the first running one, so only events of pending commands are held
+void _eclProfileAdvance(EclProfiler_t* prof) {
+    while(prof->_tail < prof->_head && _eclProfileCollect(&prof->records[prof->_tail % prof->_recordsCap], false))
+        prof->_tail++;
+}
+
+// kernel names are stored once, records point to them
+const char* _eclProfileName(EclProfiler_t* prof, const char* name) {
+    for(uint64_t key = _eclHashString(ECL_HASH_SEED, name);; key++) {
+        _EclProfileName_t* e = (_EclProfileName_t*)_eclMapFind(&prof->_names, key);
+        if(e && !strcmp(e->name, name)) return e->name;
+        if(e) continue; // hash collision
+
+        e = (_EclProfileName_t*)_eclMapInsert(&prof->_names, key, sizeof(_EclProfileName_t));
+        if(!e) return NULL;
+
+        strncpy(e->name, name, ECL_MAX_STRING_LEN - 1);
+        return e->name;
+    }
+}
+
+EclError_t _eclProfile(const EclComputer_t* comp, cl_event ev, EclProfileOp_t op, const char* name, size_t bytes) {
+    EclProfiler_t* prof = comp->prof;
+    if(!prof || !ev) return ECL_ERROR_OK;
+
+    _eclLock(&prof->_lock);
+    size_t capacity = prof->capacity ? prof->capacity : ECL_PROFILE_RECORDS;
+
+    // grow up to capacity, then overwrite the oldest record
+    if(prof->recordsSize == prof->_recordsCap && prof->_recordsCap < capacity) {
+        size_t cap = prof->_recordsCap ? 2 * prof->_recordsCap : 64;
+        if(cap > capacity) cap = capacity;
+
+        EclProfileRecord_t* records = (EclProfileRecord_t*)realloc(prof->records, cap * sizeof(EclProfileRecord_t));
+        if(!records) {
+            _eclUnlock(&prof->_lock);
+            return ECL_ERROR_OUT_OF_MEMORY;
+        }
+
+        // ring is full only at capacity, so it's still in order here
+        prof->records = records;
+        prof->_recordsCap = cap;
+    }
+
+    _eclProfileAdvance(prof);
+
+    EclProfileRecord_t* r = &prof->records[prof->_head % prof->_recordsCap];
+    if(prof->_head - prof->_tail == prof->_recordsCap) {
+        _eclProfileCollect(r, true);
+        prof->_tail++;
+    }
+
+    const char* stored = name ? _eclProfileName(prof, name) : NULL;
+    if(name && !stored) {
+        _eclUnlock(&prof->_lock);
+        return ECL_ERROR_OUT_OF_MEMORY;
+    }
+
+    memset(r, 0, sizeof(EclProfileRecord_t));
+
+    r->op = op;
+    r->name = stored;
+    r->dev = comp->dev;
+    r->bytes = bytes;
+
+    clRetainEvent(ev);
+    r->_ev = ev;
+
+    prof->_head++;
+    if(prof->recordsSize < prof->_recordsCap) prof->recordsSize++;
+    _eclUnlock(&prof->_lock);
+
+    return ECL_ERROR_OK;
+}
+
+size_t _eclRectBytes(const EclRect_t* rect, size_t size) {
+    return rect ? rect->region[0] * rect->region[1] * rect->region[2] : size;
+}
+
+EclError_t _eclCommandEnd(const EclComputer_t* comp, cl_command_queue queue, cl_event ev, EclComputerExec_t exec, EclEvent_t* event) {
+    // other queues may wait for this command
+    if(_eclTracked(comp)) clFlush(queue);
+
+    if(event) event->_ev = ev;
+    else if(ev) clReleaseEvent(ev);
+
+    if(exec == ECL_EXEC_SYNC) return eclComputerAwait(comp);
+    return ECL_ERROR_OK;
+}
+
+bool _eclCheckRange(const EclBuffer_t* arg, size_t offset, size_t size, const EclRect_t* rect) {
+    if(!rect) return offset <= arg->size && size <= arg->size - offset;
+
+    for(size_t i = 0; i < 3; i++) {
+        if(rect->region[i] == 0) return false;
+    }
+
+    size_t rowPitch = rect->rowPitch ? rect->rowPitch : rect->region[0];
+    size_t slicePitch = rect->slicePitch ? rect->slicePitch : rowPitch * rect->region[1];
+
+    size_t end = (rect->origin[2] + rect->region[2] - 1) * slicePitch + (rect->origin[1] + rect->region[1] - 1) * rowPitch + rect->origin[0] + rect->region[0];
+    return rect->origin[0] + rect->region[0] <= rowPitch && end <= arg->size;
+}
+
+// zero-copy buffers are shared as a whole, so range and rect are used only for copying buffers
+EclError_t _eclSend(EclBuffer_t* arg, size_t offset, size_t size, const EclRect_t* rect, const EclComputer_t* comp, EclComputerExec_t exec, const EclEvent_t* wait, size_t waitCount, EclEvent_t* event) {
+    if(!_eclCheckRange(arg, offset, size, rect)) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    if(_eclIsHost(comp)) {
+        if(event) event->_ev = 0;
+        return ECL_ERROR_OK;
+    }
+
+    _EclWaitList_t waitList;
+    EclError_t err = _eclWaitList(wait, waitCount, &waitList);
+    if(err != ECL_ERROR_OK) return err;
+
+    cl_mem mem = 0;
+    err = _eclCreateBuffer(arg, comp, &mem);
+    if(err != ECL_ERROR_OK) return err;
+
+    _EclBufferMap_t* e = _eclGetBufferMap(arg, comp);
+
+    bool tracked = _eclTracked(comp);
+    if(tracked) _eclWaitListAdd(&waitList, e->_ev);
+
+    cl_event ev = 0;
+    cl_event* evOut = _eclNeedEvent(comp, event) ? &ev : NULL;
+    const cl_event* waitPtr = waitList.size ? waitList.list : NULL;
+
+    int16_t tmpErr = 0;
+    if(!e->_zero && rect)
+        tmpErr = clEnqueueWriteBufferRect(comp->_upload, mem, CL_FALSE, rect->origin, rect->origin, rect->region, rect->rowPitch, rect->slicePitch, rect->rowPitch, rect->slicePitch, arg->data, waitList.size, waitPtr, evOut);
+    else if(!e->_zero)
+        tmpErr = clEnqueueWriteBuffer(comp->_upload, mem, CL_FALSE, offset, size, (uint8_t*)arg->data + offset, waitList.size, waitPtr, evOut);
+    else if(e->_mapped) {
+        // zero-copy, give memory back to device
+        tmpErr = clEnqueueUnmapMemObject(comp->_upload, mem, e->_ptr, waitList.size, waitPtr, evOut);
+        e->_mapped = false;
+    } else if(evOut)
+        tmpErr = clEnqueueMarkerWithWaitList(comp->_upload, waitList.size, waitPtr, evOut);
+
+    if(tmpErr == CL_MEM_OBJECT_ALLOCATION_FAILURE) return ECL_ERROR_ALLOCATE_BUFFER;
+    if(tmpErr == CL_OUT_OF_HOST_MEMORY || tmpErr == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    if(tmpErr == CL_INVALID_EVENT_WAIT_LIST) return ECL_ERROR_INVALID_EVENTS;
+
+    if(tracked) _eclTrackEvent(e, ev);
+
+    err = _eclProfile(comp, ev, ECL_PROFILE_SEND, NULL, e->_zero ? 0 : _eclRectBytes(rect, size));
+    if(err != ECL_ERROR_OK) return err;
+
+    return _eclCommandEnd(comp, comp->_upload, ev, exec, event);
+}
+
+EclError_t eclComputerSend(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec) {
+    return _eclSend(arg, 0, arg->size, NULL, comp, exec, NULL, 0, NULL);
+}
+
+EclError_t eclComputerSendEx(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec, const EclEvent_t* wait, size_t waitCount, EclEvent_t* event) {
+    return _eclSend(arg, 0, arg->size, NULL, comp, exec, wait, waitCount, event);
+}
+
+EclError_t eclComputerSendRange(EclBuffer_t* arg, size_t offset, size_t size, const EclComputer_t* comp, EclComputerExec_t exec) {
+    return _eclSend(arg, offset, size, NULL, comp, exec, NULL, 0, NULL);
+}
+
+EclError_t eclComputerSendRect(EclBuffer_t* arg, const EclRect_t* rect, const EclComputer_t* comp, EclComputerExec_t exec) {
+    return _eclSend(arg, 0, 0, rect, comp, exec, NULL, 0, NULL);
+}
+
+void _eclFrameOptions(const EclFrame_t* frame, char* out, size_t size) {
+    snprintf(out, size, "%s %s", frame->prog->options, frame->options);
+}
+
+EclError_t eclComputerGrid(EclFrame_t* frame, EclWorkSize_t global, EclWorkSize_t local, const EclComputer_t* comp, EclComputerExec_t exec) {
+    return eclComputerGridEx(frame, global, local, comp, exec, NULL, 0, NULL);
+}
+
+EclError_t _eclArgError(cl_int err) {
+    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    if(err == CL_INVALID_ARG_SIZE) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    return ECL_ERROR_OK;
+}
+
+// prepare buffer used by kernel
+EclError_t _eclGridBuffer(_EclBufferMap_t* e, const EclComputer_t* comp, _EclWaitList_t* waitList, _EclBufferMap_t** bufs, size_t* bufsCount) {
+    bool tracked = _eclTracked(comp);
+
+    // mapped zero-copy buffer must be unmapped before kernel uses it
+    if(e->_zero && e->_mapped) {
+        cl_event unmapEv = 0;
+
+        cl_int err;
+        out_of_memory_check(err, clEnqueueUnmapMemObject(comp->_queue, e->_mem, e->_ptr, (tracked && e->_ev) ? 1 : 0, (tracked && e->_ev) ? &e->_ev : NULL, tracked ? &unmapEv : NULL));
+        e->_mapped = false;
+
+        if(tracked) {
+            _eclTrackEvent(e, unmapEv);
+            clReleaseEvent(unmapEv);
+        }
+    }
+
+    if(tracked) {
+        _eclWaitListAdd(waitList, e->_ev);
+        bufs[(*bufsCount)++] = e;
+    }
+
+    return ECL_ERROR_OK;
+}
+
+// bytes of local memory arg, work-group total is checked against device local memory
+EclError_t _eclLocalArg(const EclFrameArg_t* arg, const EclWorkSize_t* local, const EclComputer_t* comp, size_t* total, size_t* out) {
+    size_t bytes = arg->size;
+
+    if(arg->type == ECL_ARG_LOCAL_ITEMS) {
+        if(local->dim == 0) return ECL_ERROR_INVALID_ARG_SIZE; // driver chosen work-group has unknown size
+        for(size_t d = 0; d < local->dim; d++) bytes *= local->sizes[d];
+    }
+    if(bytes == 0) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    *total += bytes;
+    if(*total > comp->dev->localMem) return ECL_ERROR_OUT_OF_LOCAL_MEMORY;
+
+    *out = bytes;
+    return ECL_ERROR_OK;
+}
+
+EclError_t _eclEnqueueGrid(cl_kernel kern, const char* name, const size_t* offset, const EclWorkSize_t* global, const EclWorkSize_t* local, const EclComputer_t* comp, EclComputerExec_t exec, const _EclWaitList_t* waitList, _EclBufferMap_t** bufs, size_t bufsCount, EclEvent_t* event) {
+    cl_event ev = 0;
+    // zero local dimension lets implementation choose work-group size
+    cl_int err = clEnqueueNDRangeKernel(comp->_queue, kern, global->dim, offset, global->sizes, local->dim ? local->sizes : NULL, waitList->size, waitList->size ? waitList->list : NULL, _eclNeedEvent(comp, event) ? &ev : NULL);
+    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    if(err == CL_INVALID_EVENT_WAIT_LIST) return ECL_ERROR_INVALID_EVENTS;
+    if(err == CL_INVALID_WORK_GROUP_SIZE || err == CL_INVALID_WORK_ITEM_SIZE) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    for(size_t i = 0; i < bufsCount; i++)
+        _eclTrackEvent(bufs[i], ev);
+
+    if(comp->prof) {
+        EclError_t tmpErr = _eclProfile(comp, ev, ECL_PROFILE_GRID, name, 0);
+        if(tmpErr != ECL_ERROR_OK) return tmpErr;
+    }
+
+    return _eclCommandEnd(comp, comp->_queue, ev, exec, event);
+}
+
+size_t _eclImagePixelSize(const EclImageFormat_t* format) {
+    size_t channels = format->channels == ECL_CHANNELS_R ? 1 : format->channels == ECL_CHANNELS_RG ? 2 : 4;
+
+    size_t size = 4;
+    if(format->type == ECL_CHANNEL_UNORM8 || format->type == ECL_CHANNEL_UINT8) size = 1;
+    else if(format->type == ECL_CHANNEL_UNORM16 || format->type == ECL_CHANNEL_UINT16 || format->type == ECL_CHANNEL_HALF) size = 2;
+
+    return channels * size;
+}
+
+EclError_t _eclImageCommand(EclImage_t* img, const EclComputer_t* comp, EclComputerExec_t exec, bool send) {
+    if(_eclIsHost(comp)) return ECL_ERROR_OK;
+
+    cl_mem mem = 0;
+    EclError_t err = ECL_ERROR_OK;
+
+    if(send) err = _eclCreateImage(img, comp, &mem);
+    if(err != ECL_ERROR_OK) return err;
+
+    _EclBufferMap_t* e = _eclGetImageMap(img, comp);
+    if(!e) return ECL_ERROR_BUFFER_NOT_SENDED;
+
+    _EclWaitList_t waitList = {};
+    bool tracked = _eclTracked(comp);
+    if(tracked) _eclWaitListAdd(&waitList, e->_ev);
+
+    size_t origin[3] = {};
+    size_t region[3] = {img->width, img->height, img->depth > 1 ? img->depth : 1};
+
+    cl_event ev = 0;
+    cl_event* evOut = _eclNeedEvent(comp, NULL) ? &ev : NULL;
+    const cl_event* waitPtr = waitList.size ? waitList.list : NULL;
+    cl_command_queue queue = send ? comp->_upload : comp->_download;
+
+    cl_int tmpErr;
+    if(send) {
+        out_of_memory_check(tmpErr, clEnqueueWriteImage(queue, e->_mem, CL_FALSE, origin, region, img->rowPitch, img->slicePitch, img->data, waitList.size, waitPtr, evOut));
+    } else {
+        out_of_memory_check(tmpErr, clEnqueueReadImage(queue, e->_mem, CL_FALSE, origin, region, img->rowPitch, img->slicePitch, img->data, waitList.size, waitPtr, evOut));
+    }
+    if(tmpErr == CL_MEM_OBJECT_ALLOCATION_FAILURE) return ECL_ERROR_ALLOCATE_BUFFER;
+    if(tmpErr == CL_INVALID_EVENT_WAIT_LIST) return ECL_ERROR_INVALID_EVENTS;
+    if(tmpErr != CL_SUCCESS) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    if(tracked) _eclTrackEvent(e, ev);
+
+    err = _eclProfile(comp, ev, send ? ECL_PROFILE_SEND : ECL_PROFILE_RECEIVE, NULL, region[0] * region[1] * region[2] * _eclImagePixelSize(&img->format));
+    if(err != ECL_ERROR_OK) return err;
+
+    return _eclCommandEnd(comp, queue, ev, exec, NULL);
+}
+
+EclError_t eclComputerSendImage(EclImage_t* img, const EclComputer_t* comp, EclComputerExec_t exec) {
+    return _eclImageCommand(img, comp, exec, true);
+}
+
+EclError_t eclComputerReceiveImage(EclImage_t* img, const EclComputer_t* comp, EclComputerExec_t exec) {
+    return _eclImageCommand(img, comp, exec, false);
+}
+
+EclError_t eclImageClear(EclImage_t* img) {
+    cl_int err = 0;
+    for(size_t i = 0; i < img->_imgSize; i++) {
+        _EclBufferMap_t* e = (_EclBufferMap_t*)_eclMapAt(&img->_img, &img->_imgMap, i);
+
+        if(e->_ev) {
+            out_of_memory_check(err, clReleaseEvent(e->_ev));
+        }
+        if(e->_mem) {
+            out_of_memory_check(err, clReleaseMemObject(e->_mem));
+        }
+    }
+    memset(&img->_img, 0, sizeof(_EclBufferMap_t));
+    _eclMapClear(&img->_imgMap);
+    img->_imgSize = 0;
+
+    img->data = NULL;
+    img->width = 0;
+    img->height = 0;
+    img->depth = 0;
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclSamplerClear(EclSampler_t* sampler) {
+    cl_int err = 0;
+    for(size_t i = 0; i < sampler->_samplerSize; i++) {
+        _EclSamplerMap_t* e = (_EclSamplerMap_t*)_eclMapAt(&sampler->_sampler, &sampler->_samplerMap, i);
+        if(e->_sampler) {
+            out_of_memory_check(err, clReleaseSampler(e->_sampler));
+        }
+    }
+    memset(&sampler->_sampler, 0, sizeof(_EclSamplerMap_t));
+    _eclMapClear(&sampler->_samplerMap);
+    sampler->_samplerSize = 0;
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclSvmAlloc(EclSvm_t* svm, const EclComputer_t* comp) {
+    svm->_comp = comp;
+    svm->_ev = 0;
+    svm->_mapped = false;
+
+    if(_eclIsHost(comp)) {
+        svm->data = calloc(1, svm->size);
+        if(!svm->data) return ECL_ERROR_OUT_OF_MEMORY;
+
+        svm->_ctx = 0;
+        svm->_host = true;
+
+        return ECL_ERROR_OK;
+    }
+
+    cl_device_svm_capabilities caps = CL_DEVICE_SVM_COARSE_GRAIN_BUFFER;
+    cl_svm_mem_flags flags = (cl_svm_mem_flags)svm->access;
+
+    if(svm->mode != ECL_SVM_COARSE) {
+        caps = CL_DEVICE_SVM_FINE_GRAIN_BUFFER;
+        flags |= CL_MEM_SVM_FINE_GRAIN_BUFFER;
+    }
+    if(svm->mode == ECL_SVM_FINE_ATOMICS) {
+        caps |= CL_DEVICE_SVM_ATOMICS;
+        flags |= CL_MEM_SVM_ATOMICS;
+    }
+    if((comp->dev->svm & caps) != caps) return ECL_ERROR_NO_SVM;
+
+    svm->data = clSVMAlloc(comp->_ctx, flags, svm->size, 0);
+    if(!svm->data) return ECL_ERROR_ALLOCATE_BUFFER;
+
+    svm->_ctx = comp->_ctx;
+    svm->_host = false;
+
+    // coarse memory starts mapped, so host can fill it
+    return eclSvmMap(svm, ECL_EXEC_SYNC);
+}
+
+EclError_t eclSvmMap(EclSvm_t* svm, EclComputerExec_t exec) {
+    if(svm->_host) return ECL_ERROR_OK;
+
+    const EclComputer_t* comp = svm->_comp;
+
+    // fine-grained memory is always shared, only wait for kernels
+    if(svm->mode != ECL_SVM_COARSE) return exec == ECL_EXEC_SYNC ? eclComputerAwait(comp) : ECL_ERROR_OK;
+    if(svm->_mapped) return ECL_ERROR_OK;
+
+    bool tracked = _eclTracked(comp);
+
+    cl_int err;
+    if(tracked) {
+        // out-of-order queue, map after every previous kernel
+        out_of_memory_check(err, clEnqueueBarrierWithWaitList(comp->_queue, 0, NULL, NULL));
+    }
+
+    cl_event ev = 0;
+    out_of_memory_check(err, clEnqueueSVMMap(comp->_queue, exec == ECL_EXEC_SYNC ? CL_TRUE : CL_FALSE, CL_MAP_READ | CL_MAP_WRITE, svm->data, svm->size, 0, NULL, tracked ? &ev : NULL));
+    if(err != CL_SUCCESS) return ECL_ERROR_ALLOCATE_BUFFER;
+
+    svm->_mapped = true;
+
+    // unmap waits for it
+    if(svm->_ev) clReleaseEvent(svm->_ev);
+    svm->_ev = ev;
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclSvmUnmap(EclSvm_t* svm, EclComputerExec_t exec) {
+    if(svm->_host || svm->mode != ECL_SVM_COARSE || !svm->_mapped) return ECL_ERROR_OK;
+
+    const EclComputer_t* comp = svm->_comp;
+    bool tracked = _eclTracked(comp);
+
+    cl_event ev = 0;
+
+    // out-of-order queue may start unmap before preceding map
+    cl_uint waitCount = tracked && svm->_ev ? 1 : 0;
+
+    cl_int err;
+    out_of_memory_check(err, clEnqueueSVMUnmap(comp->_queue, svm->data, waitCount, waitCount ? &svm->_ev : NULL, tracked ? &ev : NULL));
+    if(err != CL_SUCCESS) return ECL_ERROR_ALLOCATE_BUFFER;
+
+    svm->_mapped = false;
+
+    if(svm->_ev) clReleaseEvent(svm->_ev);
+    svm->_ev = ev;
+
+    if(exec == ECL_EXEC_SYNC) return eclComputerAwait(comp);
+    return ECL_ERROR_OK;
+}
+
+// kernel gets coarse memory back from host
+EclError_t _eclGridSvm(EclSvm_t* svm, const EclComputer_t* comp, _EclWaitList_t* waitList) {
+    if(svm->_host || svm->_ctx != comp->_ctx) return ECL_ERROR_NO_SVM;
+
+    EclError_t err = eclSvmUnmap(svm, ECL_EXEC_ASYNC);
+    if(err != ECL_ERROR_OK) return err;
+
+    if(_eclTracked(comp)) _eclWaitListAdd(waitList, svm->_ev);
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclSvmClear(EclSvm_t* svm) {
+    if(svm->_host) free(svm->data);
+    else if(svm->data) {
+        // memory may be still used by commands, so computer must be cleared after its svm memory
+        EclError_t err = eclSvmUnmap(svm, ECL_EXEC_SYNC);
+        if(err != ECL_ERROR_OK) return err;
+
+        err = eclComputerAwait(svm->_comp);
+        if(err != ECL_ERROR_OK) return err;
+
+        clSVMFree(svm->_ctx, svm->data);
+    }
+
+    if(svm->_ev) clReleaseEvent(svm->_ev);
+
+    svm->data = NULL;
+    svm->size = 0;
+    svm->_ctx = 0;
+    svm->_comp = NULL;
+    svm->_ev = 0;
+    svm->_mapped = false;
+    svm->_host = false;
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t _eclGrid(EclFrame_t* frame, const size_t* offset, EclWorkSize_t global, EclWorkSize_t local, const EclComputer_t* comp, EclComputerExec_t exec, const EclEvent_t* wait, size_t waitCount, EclEvent_t* event) {
+    if(_eclIsHost(comp)) return _eclHostGrid(frame, offset, &global, &local, comp, event);
+
+    _EclWaitList_t waitList;
+    EclError_t err = _eclWaitList(wait, waitCount, &waitList);
+    if(err != ECL_ERROR_OK) return err;
+
+    // check program
+    char options[2 * ECL_MAX_STRING_LEN];
+    _eclFrameOptions(frame, options, sizeof(options));
+
+    cl_program prog = 0;
+    err = _eclCreateProgram(frame->prog, comp, options, &prog);
+    if(err != ECL_ERROR_OK) return err;
+
+    // check kernel, vector variant handles several items per work-item
+    size_t width = _eclKernelWidth(frame->kern, comp->dev, offset, &global, &local);
+
+    cl_kernel kern = 0;
+    err = _eclCreateKernel(frame->kern, prog, width, &kern);
+    if(err != ECL_ERROR_OK) return err;
+
+    size_t vecOffset[ECL_MAX_WORKITEMS_DIMENSION];
+    if(width > 1) {
+        global.sizes[0] /= width;
+
+        if(offset) {
+            memcpy(vecOffset, offset, global.dim * sizeof(size_t));
+            vecOffset[0] /= width;
+            offset = vecOffset;
+        }
+    }
+
+    // set args
+    _EclBufferMap_t* bufs[ECL_MAX_ARRAY_SIZE];
+    size_t bufsCount = 0;
+    size_t localMem = 0;
+
+    for(size_t i = 0; i < frame->argsCount; i++) {
+        cl_int tmpErr = 0;
+
+        if(frame->args[i].type == ECL_ARG_BUFFER) {
+            _EclBufferMap_t* e = _eclGetBufferMap((EclBuffer_t*)frame->args[i].arg, comp);
+            if(!e) return ECL_ERROR_BUFFER_NOT_SENDED;
+
+            err = _eclGridBuffer(e, comp, &waitList, bufs, &bufsCount);
+            if(err != ECL_ERROR_OK) return err;
+
+            tmpErr = clSetKernelArg(kern, i, sizeof(cl_mem), &e->_mem);
+        } else if(frame->args[i].type == ECL_ARG_SVM) {
+            EclSvm_t* svm = (EclSvm_t*)frame->args[i].arg;
+
+            err = _eclGridSvm(svm, comp, &waitList);
+            if(err != ECL_ERROR_OK) return err;
+
+            tmpErr = clSetKernelArgSVMPointer(kern, i, svm->data);
+        } else if(frame->args[i].type == ECL_ARG_IMAGE) {
+            _EclBufferMap_t* e = _eclGetImageMap((EclImage_t*)frame->args[i].arg, comp);
+            if(!e) return ECL_ERROR_BUFFER_NOT_SENDED;
+
+            err = _eclGridBuffer(e, comp, &waitList, bufs, &bufsCount);
+            if(err != ECL_ERROR_OK) return err;
+
+            tmpErr = clSetKernelArg(kern, i, sizeof(cl_mem), &e->_mem);
+        } else if(frame->args[i].type == ECL_ARG_SAMPLER) {
+            cl_sampler sampler = 0;
+            err = _eclCreateSampler((EclSampler_t*)frame->args[i].arg, comp, &sampler);
+            if(err != ECL_ERROR_OK) return err;
+
+            tmpErr = clSetKernelArg(kern, i, sizeof(cl_sampler), &sampler);
+        } else if(frame->args[i].type == ECL_ARG_LOCAL || frame->args[i].type == ECL_ARG_LOCAL_ITEMS) {
+            size_t bytes = 0;
+            err = _eclLocalArg(&frame->args[i], &local, comp, &localMem, &bytes);
+            if(err != ECL_ERROR_OK) return err;
+
+            tmpErr = clSetKernelArg(kern, i, bytes, NULL);
+        } else
+            tmpErr = clSetKernelArg(kern, i, frame->args[i].size, frame->args[i].arg);
+
+        err = _eclArgError(tmpErr);
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    return _eclEnqueueGrid(kern, frame->kern->name, offset, &global, &local, comp, exec, &waitList, bufs, bufsCount, event);
+}
+
+EclError_t eclComputerGridEx(EclFrame_t* frame, EclWorkSize_t global, EclWorkSize_t local, const EclComputer_t* comp, EclComputerExec_t exec, const EclEvent_t* wait, size_t waitCount, EclEvent_t* event) {
+    return _eclGrid(frame, NULL, global, local, comp, exec, wait, waitCount, event);
+}
+
+// (re)creates plan kernel for vector width, args are set again on next launch
+EclError_t _eclPlanKernel(EclPlan_t* plan, size_t width) {
+    if(plan->_kern) {
+        cl_int err;
+        out_of_memory_check(err, clReleaseKernel(plan->_kern));
+        plan->_kern = 0;
+    }
+
+    memset(plan->_mem, 0, sizeof(plan->_mem));
+    memset(plan->_sizes, 0, sizeof(plan->_sizes));
+    plan->_width = width;
+
+    char name[ECL_MAX_STRING_LEN + 32];
+    _eclKernelName(plan->frame->kern, width, name, sizeof(name));
+
+    cl_int tmpErr = 0;
+    plan->_kern = clCreateKernel(plan->_prog, name, &tmpErr);
+    if(tmpErr == CL_OUT_OF_HOST_MEMORY || tmpErr == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+    if(tmpErr != CL_SUCCESS) return ECL_ERROR_NO_KERNEL;
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclComputerPlan(EclFrame_t* frame, EclWorkSize_t global, EclWorkSize_t local, const EclComputer_t* comp, EclPlan_t* out) {
+    if(_eclIsHost(comp)) {
+        memset(out, 0, sizeof(EclPlan_t));
+        out->frame = frame;
+        out->global = global;
+        out->local = local;
+        out->comp = comp;
+
+        return frame->kern->host ? ECL_ERROR_OK : ECL_ERROR_NO_KERNEL;
+    }
+
+    char options[2 * ECL_MAX_STRING_LEN];
+    _eclFrameOptions(frame, options, sizeof(options));
+
+    cl_program prog = 0;
+    EclError_t err = _eclCreateProgram(frame->prog, comp, options, &prog);
+    if(err != ECL_ERROR_OK) return err;
+
+    memset(out, 0, sizeof(EclPlan_t));
+    out->frame = frame;
+    out->global = global;
+    out->local = local;
+    out->comp = comp;
+    out->_prog = prog;
+
+    return _eclPlanKernel(out, _eclKernelWidth(frame->kern, comp->dev, NULL, &global, &local));
+}
+
+EclError_t eclPlanGrid(EclPlan_t* plan, EclComputerExec_t exec) {
+    return eclPlanGridEx(plan, exec, NULL, 0, NULL);
+}
+
+EclError_t eclPlanGridEx(EclPlan_t* plan, EclComputerExec_t exec, const EclEvent_t* wait, size_t waitCount, EclEvent_t* event) {
+    if(_eclIsHost(plan->comp)) return _eclHostGrid(plan->frame, NULL, &plan->global, &plan->local, plan->comp, event);
+
+    _EclWaitList_t waitList;
+    EclError_t err = _eclWaitList(wait, waitCount, &waitList);
+    if(err != ECL_ERROR_OK) return err;
+
+    const EclFrame_t* frame = plan->frame;
+    const EclComputer_t* comp = plan->comp;
+
+    // global or local changed so that other variant fits, trailing items are never dropped
+    size_t width = _eclKernelWidth(frame->kern, comp->dev, NULL, &plan->global, &plan->local);
+    if(width != plan->_width) {
+        err = _eclPlanKernel(plan, width);
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    // set only changed args
+    _EclBufferMap_t* bufs[ECL_MAX_ARRAY_SIZE];
+    size_t bufsCount = 0;
+    size_t localMem = 0;
+
+    for(size_t i = 0; i < frame->argsCount; i++) {
+        const EclFrameArg_t* arg = &frame->args[i];
+        cl_int tmpErr = 0;
+
+        if(arg->type == ECL_ARG_BUFFER || arg->type == ECL_ARG_IMAGE) {
+            _EclBufferMap_t* e = arg->type == ECL_ARG_BUFFER ? _eclGetBufferMap((EclBuffer_t*)arg->arg, comp) : _eclGetImageMap((EclImage_t*)arg->arg, comp);
+            if(!e) return ECL_ERROR_BUFFER_NOT_SENDED;
+
+            err = _eclGridBuffer(e, comp, &waitList, bufs, &bufsCount);
+            if(err != ECL_ERROR_OK) return err;
+
+            if(e->_mem == plan->_mem[i]) continue;
+
+            tmpErr = clSetKernelArg(plan->_kern, i, sizeof(cl_mem), &e->_mem);
+            err = _eclArgError(tmpErr);
+            if(err != ECL_ERROR_OK) return err;
+
+            plan->_mem[i] = e->_mem;
+            plan->_sizes[i] = 0;
+        } else if(arg->type == ECL_ARG_SVM) {
+            EclSvm_t* svm = (EclSvm_t*)arg->arg;
+
+            err = _eclGridSvm(svm, comp, &waitList);
+            if(err != ECL_ERROR_OK) return err;
+
+            tmpErr = clSetKernelArgSVMPointer(plan->_kern, i, svm->data);
+            err = _eclArgError(tmpErr);
+            if(err != ECL_ERROR_OK) return err;
+
+            plan->_mem[i] = 0;
+            plan->_sizes[i] = 0;
+        } else if(arg->type == ECL_ARG_SAMPLER) {
+            cl_sampler sampler = 0;
+            err = _eclCreateSampler((EclSampler_t*)arg->arg, comp, &sampler);
+            if(err != ECL_ERROR_OK) return err;
+
+            tmpErr = clSetKernelArg(plan->_kern, i, sizeof(cl_sampler), &sampler);
+            err = _eclArgError(tmpErr);
+            if(err != ECL_ERROR_OK) return err;
+
+            plan->_mem[i] = 0;
+            plan->_sizes[i] = 0;
+        } else if(arg->type == ECL_ARG_LOCAL || arg->type == ECL_ARG_LOCAL_ITEMS) {
+            size_t bytes = 0;
+            err = _eclLocalArg(arg, &plan->local, comp, &localMem, &bytes);
+            if(err != ECL_ERROR_OK) return err;
+
+            if(bytes == plan->_sizes[i] && !plan->_mem[i]) continue;
+
+            tmpErr = clSetKernelArg(plan->_kern, i, bytes, NULL);
+            err = _eclArgError(tmpErr);
+            if(err != ECL_ERROR_OK) return err;
+
+            plan->_mem[i] = 0;
+            plan->_sizes[i] = bytes;
+        } else {
+            bool cached = arg->size <= ECL_MAX_VAR_SIZE;
+            if(cached && arg->size == plan->_sizes[i] && memcmp(plan->_vals[i], arg->arg, arg->size) == 0) continue;
+
+            tmpErr = clSetKernelArg(plan->_kern, i, arg->size, arg->arg);
+            err = _eclArgError(tmpErr);
+            if(err != ECL_ERROR_OK) return err;
+
+            plan->_mem[i] = 0;
+            plan->_sizes[i] = cached ? arg->size : 0;
+            if(cached) memcpy(plan->_vals[i], arg->arg, arg->size);
+        }
+    }
+
+    EclWorkSize_t global = plan->global;
+    if(plan->_width > 1) global.sizes[0] /= plan->_width;
+
+    return _eclEnqueueGrid(plan->_kern, frame->kern->name, NULL, &global, &plan->local, comp, exec, &waitList, bufs, bufsCount, event);
+}
+
+EclError_t eclPlanClear(EclPlan_t* plan) {
+    if(plan->_kern) {
+        cl_int err;
+        out_of_memory_check(err, clReleaseKernel(plan->_kern));
+    }
+    memset(plan, 0, sizeof(EclPlan_t));
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t _eclReceive(EclBuffer_t* arg, size_t offset, size_t size, const EclRect_t* rect, const EclComputer_t* comp, EclComputerExec_t exec, const EclEvent_t* wait, size_t waitCount, EclEvent_t* event) {
+    if(!_eclCheckRange(arg, offset, size, rect)) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    if(_eclIsHost(comp)) {
+        if(event) event->_ev = 0;
+        return ECL_ERROR_OK;
+    }
+
+    _EclWaitList_t waitList;
+    EclError_t tmpErr = _eclWaitList(wait, waitCount, &waitList);
+    if(tmpErr != ECL_ERROR_OK) return tmpErr;
+
+    _EclBufferMap_t* e = _eclGetBufferMap(arg, comp);
+    if(!e) return ECL_ERROR_BUFFER_NOT_SENDED;
+
+    bool tracked = _eclTracked(comp);
+    if(tracked) _eclWaitListAdd(&waitList, e->_ev);
+
+    cl_event ev = 0;
+    cl_event* evOut = _eclNeedEvent(comp, event) ? &ev : NULL;
+    const cl_event* waitPtr = waitList.size ? waitList.list : NULL;
+
+    cl_int err = 0;
+    if(!e->_zero && rect) {
+        out_of_memory_check(err, clEnqueueReadBufferRect(comp->_download, e->_mem, CL_FALSE, rect->origin, rect->origin, rect->region, rect->rowPitch, rect->slicePitch, rect->rowPitch, rect->slicePitch, arg->data, waitList.size, waitPtr, evOut));
+    } else if(!e->_zero) {
+        out_of_memory_check(err, clEnqueueReadBuffer(comp->_download, e->_mem, CL_FALSE, offset, size, (uint8_t*)arg->data + offset, waitList.size, waitPtr, evOut));
+    } else if(!e->_mapped) {
+        // zero-copy, give memory to host
+        e->_ptr = clEnqueueMapBuffer(comp->_download, e->_mem, CL_FALSE, CL_MAP_READ | CL_MAP_WRITE, 0, arg->size, waitList.size, waitPtr, evOut, &err);
+        if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+        if(err == CL_MAP_FAILURE) return ECL_ERROR_ALLOCATE_BUFFER;
+
+        e->_mapped = true;
+        e->_queue = comp->_download;
+        arg->data = e->_ptr;
+    } else if(evOut) {
+        out_of_memory_check(err, clEnqueueMarkerWithWaitList(comp->_download, waitList.size, waitPtr, evOut));
+    }
+    if(err == CL_INVALID_EVENT_WAIT_LIST) return ECL_ERROR_INVALID_EVENTS;
+
+    if(tracked) _eclTrackEvent(e, ev);
+
+    tmpErr = _eclProfile(comp, ev, ECL_PROFILE_RECEIVE, NULL, e->_zero ? 0 : _eclRectBytes(rect, size));
+    if(tmpErr != ECL_ERROR_OK) return tmpErr;
+
+    return _eclCommandEnd(comp, comp->_download, ev, exec, event);
+}
+
+EclError_t eclComputerReceive(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec) {
+    return _eclReceive(arg, 0, arg->size, NULL, comp, exec, NULL, 0, NULL);
+}
+
+EclError_t eclComputerReceiveEx(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec, const EclEvent_t* wait, size_t waitCount, EclEvent_t* event) {
+    return _eclReceive(arg, 0, arg->size, NULL, comp, exec, wait, waitCount, event);
+}
+
+EclError_t eclComputerReceiveRange(EclBuffer_t* arg, size_t offset, size_t size, const EclComputer_t* comp, EclComputerExec_t exec) {
+    return _eclReceive(arg, offset, size, NULL, comp, exec, NULL, 0, NULL);
+}
+
+EclError_t eclComputerReceiveRect(EclBuffer_t* arg, const EclRect_t* rect, const EclComputer_t* comp, EclComputerExec_t exec) {
+    return _eclReceive(arg, 0, 0, rect, comp, exec, NULL, 0, NULL);
+}
+
+_EclGraphNode_t* _eclGraphAdd(EclGraph_t* graph, EclNodeType_t type, size_t* node) {
+    if(graph->_nodesSize == graph->_nodesCap) {
+        size_t cap = graph->_nodesCap ? 2 * graph->_nodesCap : 8;
+
+        _EclGraphNode_t** nodes = (_EclGraphNode_t**)realloc(graph->_nodes, cap * sizeof(_EclGraphNode_t*));
+        if(!nodes) return NULL;
+
+        graph->_nodes = nodes;
+        graph->_nodesCap = cap;
+    }
+
+    // nodes are allocated separately, so plans may point to their frames
+    _EclGraphNode_t* n = (_EclGraphNode_t*)calloc(1, sizeof(_EclGraphNode_t));
+    if(!n) return NULL;
+
+    n->type = type;
+    if(node) *node = graph->_nodesSize;
+
+    graph->_nodes[graph->_nodesSize++] = n;
+    return n;
+}
+
+EclError_t eclGraphSend(EclGraph_t* graph, EclBuffer_t* arg, size_t* node) {
+    // device memory is created on record
+    cl_mem mem = 0;
+    EclError_t err = _eclCreateBuffer(arg, graph->comp, &mem);
+    if(err != ECL_ERROR_OK) return err;
+
+    _EclGraphNode_t* n = _eclGraphAdd(graph, ECL_NODE_SEND, node);
+    if(!n) return ECL_ERROR_OUT_OF_MEMORY;
+
+    n->buf = arg;
+    return ECL_ERROR_OK;
+}
+
+// memory args are resolved on record, so missing send is reported here instead of on run
+EclError_t _eclGraphCheckArg(const EclFrameArg_t* arg, const EclComputer_t* comp) {
+    if(_eclIsHost(comp)) return ECL_ERROR_OK;
+
+    if(arg->type == ECL_ARG_BUFFER && !_eclGetBufferMap((EclBuffer_t*)arg->arg, comp)) return ECL_ERROR_BUFFER_NOT_SENDED;
+    if(arg->type == ECL_ARG_IMAGE && !_eclGetImageMap((EclImage_t*)arg->arg, comp)) return ECL_ERROR_BUFFER_NOT_SENDED;
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclGraphGrid(EclGraph_t* graph, const EclFrame_t* frame, EclWorkSize_t global, EclWorkSize_t local, size_t* node) {
+    for(size_t i = 0; i < frame->argsCount; i++) {
+        EclError_t err = _eclGraphCheckArg(&frame->args[i], graph->comp);
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    _EclGraphNode_t* n = _eclGraphAdd(graph, ECL_NODE_GRID, node);
+    if(!n) return ECL_ERROR_OUT_OF_MEMORY;
+
+    n->frame = *frame;
+
+    // program and kernel are built on record
+    EclError_t err = eclComputerPlan(&n->frame, global, local, graph->comp, &n->plan);
+    if(err != ECL_ERROR_OK) {
+        eclPlanClear(&n->plan);
+        free(n);
+        graph->_nodesSize--;
+    }
+
+    return err;
+}
+
+EclError_t eclGraphReceive(EclGraph_t* graph, EclBuffer_t* arg, size_t* node) {
+    if(!_eclIsHost(graph->comp) && !_eclGetBufferMap(arg, graph->comp)) return ECL_ERROR_BUFFER_NOT_SENDED;
+
+    _EclGraphNode_t* n = _eclGraphAdd(graph, ECL_NODE_RECEIVE, node);
+    if(!n) return ECL_ERROR_OUT_OF_MEMORY;
+
+    n->buf = arg;
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclGraphSetArg(EclGraph_t* graph, size_t node, size_t argID, EclFrameArg_t arg) {
+    if(node >= graph->_nodesSize || graph->_nodes[node]->type != ECL_NODE_GRID) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    EclFrame_t* frame = &graph->_nodes[node]->frame;
+    if(argID >= frame->argsCount) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    EclError_t err = _eclGraphCheckArg(&arg, graph->comp);
+    if(err != ECL_ERROR_OK) return err;
+
+    frame->args[argID] = arg;
+    return ECL_ERROR_OK;
+}
+
+// swap every use of two buffers, e.g. for ping-pong iterations
+EclError_t eclGraphSwapBuffers(EclGraph_t* graph, EclBuffer_t* a, EclBuffer_t* b) {
+    if(!_eclIsHost(graph->comp) && (!_eclGetBufferMap(a, graph->comp) || !_eclGetBufferMap(b, graph->comp))) return ECL_ERROR_BUFFER_NOT_SENDED;
+
+    for(size_t i = 0; i < graph->_nodesSize; i++) {
+        _EclGraphNode_t* n = graph->_nodes[i];
+
+        if(n->type != ECL_NODE_GRID) {
+            if(n->buf == a) n->buf = b;
+            else if(n->buf == b) n->buf = a;
+            continue;
+        }
+
+        for(size_t j = 0; j < n->frame.argsCount; j++) {
+            EclFrameArg_t* arg = &n->frame.args[j];
+            if(arg->type != ECL_ARG_BUFFER) continue;
+
+            if(arg->arg == a) arg->arg = b;
+            else if(arg->arg == b) arg->arg = a;
+        }
+    }
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclGraphRun(EclGraph_t* graph, EclComputerExec_t exec) {
+    const EclComputer_t* comp = graph->comp;
+
+    for(size_t i = 0; i < graph->_nodesSize; i++) {
+        _EclGraphNode_t* n = graph->_nodes[i];
+
+        EclError_t err = ECL_ERROR_OK;
+        if(n->type == ECL_NODE_SEND)
+            err = _eclSend(n->buf, 0, n->buf->size, NULL, comp, ECL_EXEC_ASYNC, NULL, 0, NULL);
+        else if(n->type == ECL_NODE_GRID)
+            err = eclPlanGridEx(&n->plan, ECL_EXEC_ASYNC, NULL, 0, NULL);
+        else
+            err = _eclReceive(n->buf, 0, n->buf->size, NULL, comp, ECL_EXEC_ASYNC, NULL, 0, NULL);
+
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    if(exec == ECL_EXEC_SYNC) return eclComputerAwait(comp);
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclGraphClear(EclGraph_t* graph) {
+    for(size_t i = 0; i < graph->_nodesSize; i++) {
+        eclPlanClear(&graph->_nodes[i]->plan);
+        free(graph->_nodes[i]);
+    }
+
+    free(graph->_nodes);
+
+    graph->_nodes = NULL;
+    graph->_nodesSize = 0;
+    graph->_nodesCap = 0;
+
+    return ECL_ERROR_OK;
+}
+
+double _eclTime() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+void _eclClusterSplit(EclCluster_t* cluster, size_t units, size_t granularity) {
+    double total = 0;
+    for(size_t i = 0; i < cluster->count; i++)
+        total += cluster->ratio[i];
+
+    size_t offset = 0;
+    for(size_t i = 0; i < cluster->count; i++) {
+        double share = total > 0 ? cluster->ratio[i] / total : 1.0 / cluster->count;
+
+        // every computer keeps at least one group, so its throughput is still measured
+        size_t left = units - offset;
+        size_t reserve = (cluster->count - 1 - i) * granularity;
+        size_t limit = left > reserve ? left - reserve : left;
+
+        size_t size = (size_t)(share * units) / granularity * granularity;
+        if(size < granularity) size = granularity;
+        if(size > limit) size = limit;
+        if(i == cluster->count - 1) size = left;
+
+        cluster->offset[i] = offset;
+        cluster->size[i] = size;
+        offset += size;
+    }
+}
+
+EclError_t _eclClusterEnqueue(EclFrame_t* frame, const EclWorkSize_t* global, const EclWorkSize_t* local, EclCluster_t* cluster, size_t id, EclEvent_t* out) {
+    const EclComputer_t* comp = cluster->comps[id];
+    size_t first = cluster->offset[id];
+    size_t count = cluster->size[id];
+
+    // send inputs
+    for(size_t i = 0; i < frame->argsCount; i++) {
+        if(frame->args[i].type != ECL_ARG_BUFFER) continue;
+
+        EclBuffer_t* buf = (EclBuffer_t*)frame->args[i].arg;
+        size_t stride = cluster->strides[i];
+
+        EclError_t err = ECL_ERROR_OK;
+        if(buf->access == ECL_BUFFER_WRITE) {
+            cl_mem mem = 0;
+            err = _eclCreateBuffer(buf, comp, &mem);
+        } else if(stride)
+            err = _eclSend(buf, first * stride, count * stride, NULL, comp, ECL_EXEC_ASYNC, NULL, 0, NULL);
+        else
+            err = _eclSend(buf, 0, buf->size, NULL, comp, ECL_EXEC_ASYNC, NULL, 0, NULL);
+
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    // compute slice
+    size_t offset[ECL_MAX_WORKITEMS_DIMENSION] = {};
+    offset[cluster->axis] = first;
+
+    EclWorkSize_t slice = *global;
+    slice.sizes[cluster->axis] = count;
+
+    EclError_t err = _eclGrid(frame, offset, slice, *local, comp, ECL_EXEC_ASYNC, NULL, 0, out);
+    if(err != ECL_ERROR_OK) return err;
+
+    // receive split outputs
+    for(size_t i = 0; i < frame->argsCount; i++) {
+        if(frame->args[i].type != ECL_ARG_BUFFER || !cluster->strides[i]) continue;
+
+        EclBuffer_t* buf = (EclBuffer_t*)frame->args[i].arg;
+        if(buf->access == ECL_BUFFER_READ) continue;
+
+        eclEventClear(out);
+
+        size_t stride = cluster->strides[i];
+        err = _eclReceive(buf, first * stride, count * stride, NULL, comp, ECL_EXEC_ASYNC, NULL, 0, out);
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    // start device now, others are enqueued meanwhile
+    if(!_eclIsHost(comp)) {
+        clFlush(comp->_upload);
+        clFlush(comp->_queue);
+        clFlush(comp->_download);
+    }
+
+    return ECL_ERROR_OK;
+}
+
+typedef struct {
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+    size_t _pending;
+    double _end[ECL_MAX_DEVICES_COUNT];
+} _EclClusterWait_t;
+
+typedef struct {
+    _EclClusterWait_t* _wait;
+    size_t _id;
+} _EclClusterSlot_t;
+
+void CL_CALLBACK _eclClusterCallback(cl_event ev, cl_int status, void* data) {
+    _EclClusterSlot_t* slot = (_EclClusterSlot_t*)data;
+    double end = _eclTime();
+
+    pthread_mutex_lock(&slot->_wait->_lock);
+    slot->_wait->_end[slot->_id] = end;
+    slot->_wait->_pending--;
+    pthread_cond_signal(&slot->_wait->_cond);
+    pthread_mutex_unlock(&slot->_wait->_lock);
+}
+
+EclError_t eclClusterGrid(EclFrame_t* frame, EclWorkSize_t global, EclWorkSize_t local, EclCluster_t* cluster) {
+    if(cluster->count == 0 || cluster->count > ECL_MAX_DEVICES_COUNT || cluster->axis >= global.dim) return ECL_ERROR_NO_DEVICE;
+
+    // whole buffer written by several computers can't be merged back
+    for(size_t i = 0; i < frame->argsCount; i++) {
+        if(frame->args[i].type != ECL_ARG_BUFFER || cluster->strides[i]) continue;
+        if(((EclBuffer_t*)frame->args[i].arg)->access != ECL_BUFFER_READ) return ECL_ERROR_INVALID_ARG_SIZE;
+    }
+
+    size_t granularity = local.dim > cluster->axis && local.sizes[cluster->axis] ? local.sizes[cluster->axis] : 1;
+    _eclClusterSplit(cluster, global.sizes[cluster->axis], granularity);
+
+    // enqueue every slice, last command of computer marks its completion
+    EclEvent_t done[ECL_MAX_DEVICES_COUNT] = {};
+    EclError_t err = ECL_ERROR_OK;
+
+    // completion is stamped by event callback, so it doesn't depend on when host looks at it
+    _EclClusterWait_t wait = {._lock = PTHREAD_MUTEX_INITIALIZER, ._cond = PTHREAD_COND_INITIALIZER};
+    _EclClusterSlot_t slots[ECL_MAX_DEVICES_COUNT];
+    bool stamped[ECL_MAX_DEVICES_COUNT] = {};
+
+    // host computers run synchronously, so they go after devices
+    double start[ECL_MAX_DEVICES_COUNT] = {};
+    for(size_t pass = 0; pass < 2; pass++) {
+        for(size_t i = 0; i < cluster->count && err == ECL_ERROR_OK; i++) {
+            bool host = _eclIsHost(cluster->comps[i]);
+            if(host != (pass == 1)) continue;
+
+            double hostStart = _eclTime();
+
+            cluster->time[i] = 0;
+            if(cluster->size[i]) err = _eclClusterEnqueue(frame, &global, &local, cluster, i, &done[i]);
+            if(host) cluster->time[i] = _eclTime() - hostStart;
+
+            // device starts when its slice is flushed, not when the whole loop started
+            start[i] = _eclTime();
+            if(host || !done[i]._ev) continue;
+
+            slots[i] = (_EclClusterSlot_t){._wait = &wait, ._id = i};
+
+            pthread_mutex_lock(&wait._lock);
+            wait._pending++;
+            pthread_mutex_unlock(&wait._lock);
+
+            if(clSetEventCallback(done[i]._ev, CL_COMPLETE, _eclClusterCallback, &slots[i]) == CL_SUCCESS) {
+                stamped[i] = true;
+                continue;
+            }
+
+            pthread_mutex_lock(&wait._lock);
+            wait._pending--;
+            pthread_mutex_unlock(&wait._lock);
+        }
+    }
+
+    // callbacks point to this frame, so they are awaited even after error
+    pthread_mutex_lock(&wait._lock);
+    while(wait._pending) pthread_cond_wait(&wait._cond, &wait._lock);
+    pthread_mutex_unlock(&wait._lock);
+
+    for(size_t i = 0; i < cluster->count; i++) {
+        if(stamped[i]) cluster->time[i] = wait._end[i] - start[i];
+        else if(done[i]._ev && !_eclIsHost(cluster->comps[i])) {
+            // no callback, measured on wait
+            clWaitForEvents(1, &done[i]._ev);
+            cluster->time[i] = _eclTime() - start[i];
+        }
+    }
+
+    pthread_mutex_destroy(&wait._lock);
+    pthread_cond_destroy(&wait._cond);
+
+    for(size_t i = 0; i < cluster->count; i++) {
+        EclError_t tmpErr = eclComputerAwait(cluster->comps[i]);
+        if(err == ECL_ERROR_OK) err = tmpErr;
+
+        eclEventClear(&done[i]);
+    }
+    if(err != ECL_ERROR_OK) return err;
+
+    // rebalance from throughput, smoothed with previous ratio
+    double total = 0;
+    double throughput[ECL_MAX_DEVICES_COUNT] = {};
+
+    for(size_t i = 0; i < cluster->count; i++) {
+        if(cluster->size[i] && cluster->time[i] > 0) throughput[i] = cluster->size[i] / cluster->time[i];
+        total += throughput[i];
+    }
+    if(total <= 0) return ECL_ERROR_OK;
+
+    double ratioTotal = 0;
+    for(size_t i = 0; i < cluster->count; i++)
+        ratioTotal += cluster->ratio[i];
+
+    for(size_t i = 0; i < cluster->count; i++) {
+        double prev = ratioTotal > 0 ? cluster->ratio[i] / ratioTotal : 1.0 / cluster->count;
+        double next = cluster->size[i] ? throughput[i] / total : prev;
+
+        cluster->ratio[i] = 0.5 * prev + 0.5 * next;
+    }
+
+    return ECL_ERROR_OK;
+}
+
+uint64_t _eclTunerKey(const EclFrame_t* frame, const char* options, const EclWorkSize_t* global, const EclDevice_t* dev) {
+    uint64_t key = _eclProgramCacheKey(frame->prog, dev, options);
+    key = _eclHashString(key, frame->kern->name);
+    key = _eclHash(key, &global->dim, sizeof(size_t));
+    key = _eclHash(key, global->sizes, global->dim * sizeof(size_t));
+
+    return key;
+}
+
+// text file, line per result: key dim sizes...
+EclError_t _eclTunerLoad(EclTuner_t* tuner) {
+    tuner->_loaded = true;
+
+    FILE* f = fopen(tuner->file, "r");
+    if(!f) return ECL_ERROR_OK;
+
+    unsigned long long key = 0;
+    size_t dim = 0;
+
+    while(fscanf(f, "%llx %zu", &key, &dim) == 2) {
+        if(dim > 3) break;
+
+        EclWorkSize_t local = {.dim = dim};
+        bool ok = true;
+
+        for(size_t i = 0; i < dim && ok; i++)
+            ok = fscanf(f, "%zu", &local.sizes[i]) == 1;
+        if(!ok) break;
+
+        _EclTunerMap_t* e = (_EclTunerMap_t*)_eclMapFind(&tuner->_results, key);
+        if(!e) e = (_EclTunerMap_t*)_eclMapInsert(&tuner->_results, key, sizeof(_EclTunerMap_t));
+
+        if(!e) {
+            fclose(f);
+            return ECL_ERROR_OUT_OF_MEMORY;
+        }
+        e->local = local;
+    }
+
+    fclose(f);
+    return ECL_ERROR_OK;
+}
+
+EclError_t _eclTunerSave(const EclTuner_t* tuner) {
+    char tmpPath[ECL_MAX_STRING_LEN + 64];
+
+    FILE* f = _eclOpenTemp(tuner->file, tmpPath, sizeof(tmpPath), "w");
+    if(!f) return ECL_ERROR_WRITE_FILE;
+
+    for(size_t i = 0; i < tuner->_results._size; i++) {
+        const _EclTunerMap_t* e = (const _EclTunerMap_t*)tuner->_results._items[i];
+
+        fprintf(f, "%016llx %zu", (unsigned long long)e->_key, e->local.dim);
+        for(size_t j = 0; j < e->local.dim; j++)
+            fprintf(f, " %zu", e->local.sizes[j]);
+        fprintf(f, "\n");
+    }
+
+    if(fclose(f) != 0 || rename(tmpPath, tuner->file) != 0) {
+        remove(tmpPath);
+        return ECL_ERROR_WRITE_FILE;
+    }
+
+    return ECL_ERROR_OK;
+}
+
+// candidates are multiples of preferred size along first axis and powers of two along others, global must be divisible
+size_t _eclTunerCandidates(const EclWorkSize_t* global, const EclDevice_t* dev, size_t maxSize, size_t multiple, bool explicitLocal, EclWorkSize_t* out, size_t size) {
+    size_t count = 0;
+    if(!explicitLocal) out[count++] = (EclWorkSize_t){.dim = 0}; // implementation choice
+
+    if(global->dim == 0 || global->dim > 3) return count;
+
+    for(size_t x = multiple; x <= maxSize && x <= dev->wrki.sizes[0]; x *= 2) {
+        if(global->sizes[0] % x) continue;
+
+        for(size_t y = 1; x * y <= maxSize; y *= 2) {
+            if(global->dim < 2 && y > 1) break;
+            if(global->dim >= 2 && (y > dev->wrki.sizes[1] || global->sizes[1] % y)) break;
+
+            if(count == size) return count;
+
+            EclWorkSize_t local = {.dim = global->dim, .sizes = {x, y, 1}};
+            out[count++] = local;
+        }
+    }
+
+    return count;
+}
+
+EclError_t eclComputerTune(EclFrame_t* frame, EclWorkSize_t global, const EclComputer_t* comp, EclTuner_t* tuner, EclWorkSize_t* local) {
+    // host splits grid itself
+    if(_eclIsHost(comp)) {
+        *local = (EclWorkSize_t){.dim = 0};
+        return ECL_ERROR_OK;
+    }
+
+    if(tuner->file[0] && !tuner->_loaded) {
+        EclError_t err = _eclTunerLoad(tuner);
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    char options[2 * ECL_MAX_STRING_LEN];
+    _eclFrameOptions(frame, options, sizeof(options));
+
+    uint64_t key = _eclTunerKey(frame, options, &global, comp->dev);
+
+    _EclTunerMap_t* e = (_EclTunerMap_t*)_eclMapFind(&tuner->_results, key);
+    if(e) {
+        *local = e->local;
+        return ECL_ERROR_OK;
+    }
+
+    // get kernel limits
+    cl_program prog = 0;
+    EclError_t err = _eclCreateProgram(frame->prog, comp, options, &prog);
+    if(err != ECL_ERROR_OK) return err;
+
+    cl_kernel kern = 0;
+    err = _eclCreateKernel(frame->kern, prog, 1, &kern);
+    if(err != ECL_ERROR_OK) return err;
+
+    size_t maxSize = 0;
+    size_t multiple = 1;
+
+    cl_int tmpErr;
+    out_of_memory_check(tmpErr, clGetKernelWorkGroupInfo(kern, comp->dev->_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &maxSize, NULL));
+    out_of_memory_check(tmpErr, clGetKernelWorkGroupInfo(kern, comp->dev->_id, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(size_t), &multiple, NULL));
+    if(multiple == 0) multiple = 1;
+
+    // local items args need known work-group size
+    bool explicitLocal = false;
+    for(size_t i = 0; i < frame->argsCount; i++) {
+        if(frame->args[i].type == ECL_ARG_LOCAL_ITEMS) explicitLocal = true;
+    }
+
+    EclWorkSize_t candidates[ECL_MAX_ARRAY_SIZE];
+    size_t count = _eclTunerCandidates(&global, comp->dev, maxSize, multiple, explicitLocal, candidates, ECL_MAX_ARRAY_SIZE);
+
+    // time every candidate, kernel is launched with frame args so it should be idempotent
+    size_t repeats = tuner->repeats ? tuner->repeats : 5;
+
+    double best = 0;
+    size_t bestID = count;
+
+    // error of last rejected candidate, returned when none fits
+    EclError_t skipErr = ECL_ERROR_INVALID_ARG_SIZE;
+
+    for(size_t i = 0; i < count; i++) {
+        // warm up, candidates over local memory or work-group limits are skipped
+        err = _eclGrid(frame, NULL, global, candidates[i], comp, ECL_EXEC_SYNC, NULL, 0, NULL);
+        if(err == ECL_ERROR_INVALID_ARG_SIZE || err == ECL_ERROR_OUT_OF_LOCAL_MEMORY) {
+            skipErr = err;
+            continue;
+        }
+        if(err != ECL_ERROR_OK) return err;
+
+        double start = _eclTime();
+        for(size_t j = 0; j < repeats && err == ECL_ERROR_OK; j++)
+            err = _eclGrid(frame, NULL, global, candidates[i], comp, ECL_EXEC_ASYNC, NULL, 0, NULL);
+
+        EclError_t awaitErr = eclComputerAwait(comp);
+        if(err != ECL_ERROR_OK) return err;
+        if(awaitErr != ECL_ERROR_OK) return awaitErr;
+
+        double time = _eclTime() - start;
+        if(bestID == count || time < best) {
+            best = time;
+            bestID = i;
+        }
+    }
+
+    if(bestID == count) return skipErr;
+
+    // store result
+    e = (_EclTunerMap_t*)_eclMapInsert(&tuner->_results, key, sizeof(_EclTunerMap_t));
+    if(!e) return ECL_ERROR_OUT_OF_MEMORY;
+
+    e->local = candidates[bestID];
+    *local = e->local;
+
+    if(tuner->file[0]) return _eclTunerSave(tuner);
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclTunerClear(EclTuner_t* tuner) {
+    _eclMapClear(&tuner->_results);
+    tuner->_loaded = false;
+
+    return ECL_ERROR_OK;
+}
+
+// primitives sources, options: T, ID (identity), OPN (EclOp_t), WG (work-group size), BINS
+static const char _eclScanSrc[] =
+    "#if OPN==1\n#define OP(a,b) min(a,b)\n#elif OPN==2\n#define OP(a,b) max(a,b)\n#else\n#define OP(a,b) ((a)+(b))\n#endif\n"
+    // group reduces its chunk [g*b, g*b+b)
+    "kernel void reduce(global const T* in,global T* out,uint n,uint b){\n"
+    "local T t[WG];uint l=get_local_id(0),g=get_group_id(0),s=g*b,e=min(s+b,n);T a=ID;\n"
+    "for(uint i=s+l;i<e;i+=WG)a=OP(a,in[i]);\n"
+    "t[l]=a;\n"
+    "for(uint k=WG/2;k>0;k>>=1){barrier(CLK_LOCAL_MEM_FENCE);if(l<k)t[l]=OP(t[l],t[l+k]);}\n"
+    "if(!l)out[g]=t[0];}\n"
+    // group scans its chunk tile by tile starting from its sum, in may be out
+    "kernel void scan(global const T* in,global T* out,global const T* sums,uint n,uint b,uint ex,uint us){\n"
+    "local T t[WG];uint l=get_local_id(0),g=get_group_id(0),s=g*b,e=min(s+b,n);T c=us?sums[g]:ID;\n"
+    "for(uint o=s;o<e;o+=WG){uint i=o+l;t[l]=i<e?in[i]:ID;\n"
+    "for(uint k=1;k<WG;k<<=1){barrier(CLK_LOCAL_MEM_FENCE);T x=l>=k?t[l-k]:ID;barrier(CLK_LOCAL_MEM_FENCE);t[l]=OP(t[l],x);}\n"
+    "barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "if(i<e)out[i]=ex?(l?OP(c,t[l-1]):c):OP(c,t[l]);\n"
+    "c=OP(c,t[WG-1]);barrier(CLK_LOCAL_MEM_FENCE);}}\n";
+
+static const char _eclSortSrc[] =
+    // digits count per group, digit-major so scan gives scatter offsets
+    "kernel void count(global const uint* k,global uint* c,uint n,uint b,uint sh){\n"
+    "local uint h[16];uint l=get_local_id(0),g=get_group_id(0),s=g*b,e=min(s+b,n);\n"
+    "for(uint d=l;d<16;d+=WG)h[d]=0;\n"
+    "barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "for(uint i=s+l;i<e;i+=WG)atomic_inc(&h[(k[i]>>sh)&15]);\n"
+    "barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "for(uint d=l;d<16;d+=WG)c[d*get_num_groups(0)+g]=h[d];}\n"
+    // tile is sorted by digit with 4 stable splits, then scattered, padding goes last
+    "kernel void scatter(global const uint* k,global uint* out,global const uint* c,uint n,uint b,uint sh){\n"
+    "local uint t[WG],f[WG],p[16],h[16];uint l=get_local_id(0),g=get_group_id(0),s=g*b,e=min(s+b,n);\n"
+    "for(uint d=l;d<16;d+=WG)p[d]=c[d*get_num_groups(0)+g];\n"
+    "for(uint o=s;o<e;o+=WG){uint v=o+l<e?k[o+l]:0xffffffff;\n"
+    "for(uint j=0;j<4;j++){uint x=(v>>(sh+j))&1;barrier(CLK_LOCAL_MEM_FENCE);f[l]=!x;\n"
+    "for(uint q=1;q<WG;q<<=1){barrier(CLK_LOCAL_MEM_FENCE);uint y=l>=q?f[l-q]:0;barrier(CLK_LOCAL_MEM_FENCE);f[l]+=y;}\n"
+    "barrier(CLK_LOCAL_MEM_FENCE);uint z=f[WG-1],d=x?z+l-f[l]:f[l]-1;barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "t[d]=v;barrier(CLK_LOCAL_MEM_FENCE);v=t[l];}\n"
+    "uint dg=(v>>sh)&15,st=0;for(uint d=l;d<16;d+=WG)h[d]=0;\n"
+    "barrier(CLK_LOCAL_MEM_FENCE);if(o+l<e)atomic_inc(&h[dg]);barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "for(uint d=0;d<dg;d++)st+=h[d];\n"
+    "if(o+l<e)out[p[dg]+l-st]=v;\n"
+    "barrier(CLK_LOCAL_MEM_FENCE);for(uint d=l;d<16;d+=WG)p[d]+=h[d];}}\n"
+    "kernel void compact(global const uint* in,global const uint* f,global const uint* p,global uint* out,global uint* c,uint n){\n"
+    "uint i=get_global_id(0);if(i>=n)return;\n"
+    "if(f[i])out[p[i]]=in[i];\n"
+    "if(i==n-1)c[0]=p[i]+(f[i]?1:0);}\n"
+    "kernel void zero(global uint* out,uint n){uint i=get_global_id(0);if(i<n)out[i]=0;}\n";
+
+static const char _eclHistSrc[] =
+    "kernel void histogram(global const uint* in,global uint* out,uint n,uint b){\n"
+    "local uint h[BINS];uint l=get_local_id(0),g=get_group_id(0),s=g*b,e=min(s+b,n);\n"
+    "for(uint d=l;d<BINS;d+=WG)h[d]=0;\n"
+    "barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "for(uint i=s+l;i<e;i+=WG){uint v=in[i];if(v<BINS)atomic_inc(&h[v]);}\n"
+    "barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "for(uint d=l;d<BINS;d+=WG)if(h[d])atomic_add(&out[d],h[d]);}\n";
+
+typedef struct {
+    size_t wg; // work-group size
+    size_t groups;
+    size_t chunk; // items per group, multiple of wg
+} _EclPrimGrid_t;
+
+void _eclPrimInit(EclPrimitives_t* prims) {
+    if(prims->_scanProg.src[0]) return;
+
+    strcpy(prims->_scanProg.src, _eclScanSrc);
+    strcpy(prims->_sortProg.src, _eclSortSrc);
+    strcpy(prims->_histProg.src, _eclHistSrc);
+
+    strcpy(prims->_reduce.name, "reduce");
+    strcpy(prims->_scan.name, "scan");
+    strcpy(prims->_count.name, "count");
+    strcpy(prims->_scatter.name, "scatter");
+    strcpy(prims->_compact.name, "compact");
+    strcpy(prims->_zero.name, "zero");
+    strcpy(prims->_hist.name, "histogram");
+}
+
+// few groups per compute unit, every group walks its own contiguous chunk
+_EclPrimGrid_t _eclPrimGrid(const EclComputer_t* comp, size_t n) {
+    size_t limit = comp->dev->wrkgSize < ECL_MAX_PRIM_GROUP ? comp->dev->wrkgSize : ECL_MAX_PRIM_GROUP;
+
+    _EclPrimGrid_t grid = {.wg = 1};
+    while(grid.wg * 2 <= limit) grid.wg *= 2;
+
+    size_t groups = (n + grid.wg - 1) / grid.wg;
+    size_t maxGroups = comp->dev->cu ? comp->dev->cu * 4 : 1;
+    if(groups > maxGroups) groups = maxGroups;
+    if(groups > grid.wg) groups = grid.wg; // group sums are scanned by one group
+    if(!groups) groups = 1;
+
+    size_t tiles = ((n + groups - 1) / groups + grid.wg - 1) / grid.wg;
+    grid.chunk = (tiles ? tiles : 1) * grid.wg;
+    grid.groups = (n + grid.chunk - 1) / grid.chunk;
+    if(!grid.groups) grid.groups = 1;
+
+    return grid;
+}
+
+EclError_t _eclPrimLaunch(EclProgram_t* prog, EclKernel_t* kern, const char* options, const EclFrameArg_t* args, size_t argsCount, size_t groups, size_t wg, const EclComputer_t* comp, EclComputerExec_t exec) {
+    EclFrame_t frame = {.prog = prog, .kern = kern, .argsCount = argsCount};
+    memcpy(frame.args, args, argsCount * sizeof(EclFrameArg_t));
+    snprintf(frame.options, sizeof(frame.options), "%s", options);
+
+    EclWorkSize_t global = {.dim = 1, .sizes = {groups * wg}};
+    EclWorkSize_t local = {.dim = 1, .sizes = {wg}};
+
+    return eclComputerGrid(&frame, global, local, comp, exec);
+}
+
+// device-only scratch buffer, grown when too small
+EclError_t _eclPrimTemp(EclBuffer_t* buf, size_t size, const EclComputer_t* comp) {
+    if(buf->size < size) {
+        EclError_t err = eclBufferClear(buf);
+        if(err != ECL_ERROR_OK) return err;
+
+        buf->size = size;
+        buf->access = ECL_BUFFER_READ_WRITE;
+    }
+
+    cl_mem mem;
+    return _eclCreateBuffer(buf, comp, &mem);
+}
+
+// results stay on device, so outputs are created there without upload
+EclError_t _eclPrimOutput(EclBuffer_t* buf, const EclComputer_t* comp) {
+    cl_mem mem;
+    return _eclCreateBuffer(buf, comp, &mem);
+}
+
+void _eclPrimOptions(EclType_t type, EclOp_t op, size_t wg, char* out, size_t size) {
+    const char* names[] = {"int", "uint", "float"};
+
+    const char* id = "0";
+    if(op == ECL_OP_MIN) id = type == ECL_TYPE_INT ? "INT_MAX" : type == ECL_TYPE_UINT ? "UINT_MAX" : "INFINITY";
+    if(op == ECL_OP_MAX) id = type == ECL_TYPE_INT ? "INT_MIN" : type == ECL_TYPE_UINT ? "0" : "-INFINITY";
+
+    snprintf(out, size, "-D T=%s -D ID=%s -D OPN=%d -D WG=%zu", names[type], id, op, wg);
+}
+
+// reduce-then-scan: group sums, scan of sums by one group, scan of chunks from their sums
+EclError_t _eclPrimScan(EclPrimitives_t* prims, const char* options, _EclPrimGrid_t grid, bool exclusive, EclBuffer_t* in, EclBuffer_t* out, size_t n, const EclComputer_t* comp, EclComputerExec_t exec) {
+    uint32_t count = n;
+    uint32_t chunk = grid.chunk;
+    uint32_t groups = grid.groups;
+    uint32_t ex = exclusive;
+    uint32_t no = 0;
+    uint32_t yes = 1;
+
+    EclError_t err = _eclPrimTemp(&prims->_sums, ECL_MAX_PRIM_GROUP * sizeof(uint32_t), comp);
+    if(err != ECL_ERROR_OK) return err;
+
+    if(grid.groups > 1) {
+        EclFrameArg_t reduce[] = {
+            {ECL_ARG_BUFFER, in},
+            {ECL_ARG_BUFFER, &prims->_sums},
+            {ECL_ARG_VAR, &count, sizeof(uint32_t)},
+            {ECL_ARG_VAR, &chunk, sizeof(uint32_t)}
+        };
+        err = _eclPrimLaunch(&prims->_scanProg, &prims->_reduce, options, reduce, 4, grid.groups, grid.wg, comp, ECL_EXEC_ASYNC);
+        if(err != ECL_ERROR_OK) return err;
+
+        EclFrameArg_t sums[] = {
+            {ECL_ARG_BUFFER, &prims->_sums},
+            {ECL_ARG_BUFFER, &prims->_sums},
+            {ECL_ARG_BUFFER, &prims->_sums},
+            {ECL_ARG_VAR, &groups, sizeof(uint32_t)},
+            {ECL_ARG_VAR, &groups, sizeof(uint32_t)},
+            {ECL_ARG_VAR, &yes, sizeof(uint32_t)},
+            {ECL_ARG_VAR, &no, sizeof(uint32_t)}
+        };
+        err = _eclPrimLaunch(&prims->_scanProg, &prims->_scan, options, sums, 7, 1, grid.wg, comp, ECL_EXEC_ASYNC);
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    EclFrameArg_t scan[] = {
+        {ECL_ARG_BUFFER, in},
+        {ECL_ARG_BUFFER, out},
+        {ECL_ARG_BUFFER, &prims->_sums},
+        {ECL_ARG_VAR, &count, sizeof(uint32_t)},
+        {ECL_ARG_VAR, &chunk, sizeof(uint32_t)},
+        {ECL_ARG_VAR, &ex, sizeof(uint32_t)},
+        {ECL_ARG_VAR, grid.groups > 1 ? &yes : &no, sizeof(uint32_t)}
+    };
+    return _eclPrimLaunch(&prims->_scanProg, &prims->_scan, options, scan, 7, grid.groups, grid.wg, comp, exec);
+}
+
+EclError_t _eclPrimZero(EclPrimitives_t* prims, EclBuffer_t* buf, size_t n, size_t wg, const EclComputer_t* comp, EclComputerExec_t exec) {
+    char options[ECL_MAX_STRING_LEN];
+    snprintf(options, sizeof(options), "-D WG=%zu", wg);
+
+    uint32_t count = n;
+    EclFrameArg_t args[] = {
+        {ECL_ARG_BUFFER, buf},
+        {ECL_ARG_VAR, &count, sizeof(uint32_t)}
+    };
+    return _eclPrimLaunch(&prims->_sortProg, &prims->_zero, options, args, 2, (n + wg - 1) / wg, wg, comp, exec);
+}
+
+// host computers run primitives serially on buffers data
+void _eclHostCombine(EclType_t type, EclOp_t op, void* acc, const void* v) {
+    if(type == ECL_TYPE_FLOAT) {
+        float a = *(float*)acc;
+        float b = *(const float*)v;
+        *(float*)acc = op == ECL_OP_MIN ? (b < a ? b : a) : op == ECL_OP_MAX ? (b > a ? b : a) : a + b;
+    } else if(type == ECL_TYPE_INT && op != ECL_OP_SUM) {
+        int32_t a = *(int32_t*)acc;
+        int32_t b = *(const int32_t*)v;
+        *(int32_t*)acc = op == ECL_OP_MIN ? (b < a ? b : a) : (b > a ? b : a);
+    } else {
+        // int sum wraps like on device
+        uint32_t a = *(uint32_t*)acc;
+        uint32_t b = *(const uint32_t*)v;
+        *(uint32_t*)acc = op == ECL_OP_MIN ? (b < a ? b : a) : op == ECL_OP_MAX ? (b > a ? b : a) : a + b;
+    }
+}
+
+void _eclHostIdentity(EclType_t type, EclOp_t op, void* out) {
+    if(type == ECL_TYPE_FLOAT) *(float*)out = op == ECL_OP_MIN ? INFINITY : op == ECL_OP_MAX ? -INFINITY : 0;
+    else if(type == ECL_TYPE_INT) *(int32_t*)out = op == ECL_OP_MIN ? INT32_MAX : op == ECL_OP_MAX ? INT32_MIN : 0;
+    else *(uint32_t*)out = op == ECL_OP_MIN ? UINT32_MAX : 0;
+}
+
+int _eclHostCompareKeys(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+EclError_t eclComputerReduce(EclPrimitives_t* prims, EclType_t type, EclOp_t op, EclBuffer_t* in, EclBuffer_t* out, const EclComputer_t* comp, EclComputerExec_t exec) {
+    size_t n = in->size / sizeof(uint32_t);
+    if(out->size < sizeof(uint32_t) || n > UINT32_MAX) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    if(_eclIsHost(comp)) {
+        uint32_t acc;
+        _eclHostIdentity(type, op, &acc);
+        for(size_t i = 0; i < n; i++)
+            _eclHostCombine(type, op, &acc, (uint32_t*)in->data + i);
+
+        memcpy(out->data, &acc, sizeof(uint32_t));
+        return ECL_ERROR_OK;
+    }
+
+    _eclPrimInit(prims);
+    _EclPrimGrid_t grid = _eclPrimGrid(comp, n);
+
+    char options[ECL_MAX_STRING_LEN];
+    _eclPrimOptions(type, op, grid.wg, options, sizeof(options));
+
+    uint32_t count = n;
+    uint32_t chunk = grid.chunk;
+    uint32_t groups = grid.groups;
+
+    EclError_t err = _eclPrimOutput(out, comp);
+    if(err != ECL_ERROR_OK) return err;
+
+    err = _eclPrimTemp(&prims->_sums, ECL_MAX_PRIM_GROUP * sizeof(uint32_t), comp);
+    if(err != ECL_ERROR_OK) return err;
+
+    EclFrameArg_t first[] = {
+        {ECL_ARG_BUFFER, in},
+        {ECL_ARG_BUFFER, grid.groups > 1 ? &prims->_sums : out},
+        {ECL_ARG_VAR, &count, sizeof(uint32_t)},
+        {ECL_ARG_VAR, &chunk, sizeof(uint32_t)}
+    };
+    err = _eclPrimLaunch(&prims->_scanProg, &prims->_reduce, options, first, 4, grid.groups, grid.wg, comp, grid.groups > 1 ? ECL_EXEC_ASYNC : exec);
+    if(err != ECL_ERROR_OK || grid.groups == 1) return err;
+
+    // one group reduces partials
+    EclFrameArg_t second[] = {
+        {ECL_ARG_BUFFER, &prims->_sums},
+        {ECL_ARG_BUFFER, out},
+        {ECL_ARG_VAR, &groups, sizeof(uint32_t)},
+        {ECL_ARG_VAR, &groups, sizeof(uint32_t)}
+    };
+    return _eclPrimLaunch(&prims->_scanProg, &prims->_reduce, options, second, 4, 1, grid.wg, comp, exec);
+}
+
+EclError_t eclComputerScan(EclPrimitives_t* prims, EclType_t type, EclOp_t op, bool exclusive, EclBuffer_t* in, EclBuffer_t* out, const EclComputer_t* comp, EclComputerExec_t exec) {
+    size_t n = in->size / sizeof(uint32_t);
+    if(out->size < n * sizeof(uint32_t) || n > UINT32_MAX) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    if(_eclIsHost(comp)) {
+        uint32_t acc;
+        _eclHostIdentity(type, op, &acc);
+        for(size_t i = 0; i < n; i++) {
+            uint32_t v = ((uint32_t*)in->data)[i]; // in may be out
+            if(exclusive) ((uint32_t*)out->data)[i] = acc;
+            _eclHostCombine(type, op, &acc, &v);
+            if(!exclusive) ((uint32_t*)out->data)[i] = acc;
+        }
+        return ECL_ERROR_OK;
+    }
+    if(!n) return ECL_ERROR_OK;
+
+    _eclPrimInit(prims);
+    _EclPrimGrid_t grid = _eclPrimGrid(comp, n);
+
+    char options[ECL_MAX_STRING_LEN];
+    _eclPrimOptions(type, op, grid.wg, options, sizeof(options));
+
+    EclError_t err = _eclPrimOutput(out, comp);
+    if(err != ECL_ERROR_OK) return err;
+
+    return _eclPrimScan(prims, options, grid, exclusive, in, out, n, comp, exec);
+}
+
+// lsd radix sort by 4 bits, 8 passes leave keys in place
+EclError_t eclComputerSort(EclPrimitives_t* prims, EclBuffer_t* keys, const EclComputer_t* comp, EclComputerExec_t exec) {
+    size_t n = keys->size / sizeof(uint32_t);
+    if(n > UINT32_MAX) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    if(_eclIsHost(comp)) {
+        qsort(keys->data, n, sizeof(uint32_t), _eclHostCompareKeys);
+        return ECL_ERROR_OK;
+    }
+    if(n < 2) return ECL_ERROR_OK;
+
+    _eclPrimInit(prims);
+    _EclPrimGrid_t grid = _eclPrimGrid(comp, n);
+
+    char options[ECL_MAX_STRING_LEN];
+    snprintf(options, sizeof(options), "-D WG=%zu", grid.wg);
+
+    // digit offsets are scanned as uint sums with their own grid
+    size_t digits = 16 * grid.groups;
+    _EclPrimGrid_t countsGrid = _eclPrimGrid(comp, digits);
+
+    char countsOptions[ECL_MAX_STRING_LEN];
+    _eclPrimOptions(ECL_TYPE_UINT, ECL_OP_SUM, countsGrid.wg, countsOptions, sizeof(countsOptions));
+
+    EclError_t err = _eclPrimTemp(&prims->_counts, 16 * ECL_MAX_PRIM_GROUP * sizeof(uint32_t), comp);
+    if(err != ECL_ERROR_OK) return err;
+
+    err = _eclPrimTemp(&prims->_tmp, n * sizeof(uint32_t), comp);
+    if(err != ECL_ERROR_OK) return err;
+
+    uint32_t count = n;
+    uint32_t chunk = grid.chunk;
+
+    EclBuffer_t* src = keys;
+    EclBuffer_t* dst = &prims->_tmp;
+
+    for(uint32_t shift = 0; shift < 32; shift += 4) {
+        EclFrameArg_t countArgs[] = {
+            {ECL_ARG_BUFFER, src},
+            {ECL_ARG_BUFFER, &prims->_counts},
+            {ECL_ARG_VAR, &count, sizeof(uint32_t)},
+            {ECL_ARG_VAR, &chunk, sizeof(uint32_t)},
+            {ECL_ARG_VAR, &shift, sizeof(uint32_t)}
+        };
+        err = _eclPrimLaunch(&prims->_sortProg, &prims->_count, options, countArgs, 5, grid.groups, grid.wg, comp, ECL_EXEC_ASYNC);
+        if(err != ECL_ERROR_OK) return err;
+
+        err = _eclPrimScan(prims, countsOptions, countsGrid, true, &prims->_counts, &prims->_counts, digits, comp, ECL_EXEC_ASYNC);
+        if(err != ECL_ERROR_OK) return err;
+
+        EclFrameArg_t scatterArgs[] = {
+            {ECL_ARG_BUFFER, src},
+            {ECL_ARG_BUFFER, dst},
+            {ECL_ARG_BUFFER, &prims->_counts},
+            {ECL_ARG_VAR, &count, sizeof(uint32_t)},
+            {ECL_ARG_VAR, &chunk, sizeof(uint32_t)},
+            {ECL_ARG_VAR, &shift, sizeof(uint32_t)}
+        };
+        err = _eclPrimLaunch(&prims->_sortProg, &prims->_scatter, options, scatterArgs, 6, grid.groups, grid.wg, comp, shift == 28 ? exec : ECL_EXEC_ASYNC);
+        if(err != ECL_ERROR_OK) return err;
+
+        EclBuffer_t* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    return ECL_ERROR_OK;
+}
+
+// values >= bins are skipped
+EclError_t eclComputerHistogram(EclPrimitives_t* prims, EclBuffer_t* in, size_t bins, EclBuffer_t* out, const EclComputer_t* comp, EclComputerExec_t exec) {
+    size_t n = in->size / sizeof(uint32_t);
+    if(!bins || bins > ECL_MAX_HISTOGRAM_BINS || out->size < bins * sizeof(uint32_t) || n > UINT32_MAX) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    if(_eclIsHost(comp)) {
+        uint32_t* hist = (uint32_t*)out->data;
+        memset(hist, 0, bins * sizeof(uint32_t));
+
+        for(size_t i = 0; i < n; i++) {
+            uint32_t v = ((uint32_t*)in->data)[i];
+            if(v < bins) hist[v]++;
+        }
+        return ECL_ERROR_OK;
+    }
+
+    _eclPrimInit(prims);
+    _EclPrimGrid_t grid = _eclPrimGrid(comp, n);
+
+    EclError_t err = _eclPrimOutput(out, comp);
+    if(err != ECL_ERROR_OK) return err;
+
+    err = _eclPrimZero(prims, out, bins, grid.wg, comp, n ? ECL_EXEC_ASYNC : exec);
+    if(err != ECL_ERROR_OK || !n) return err;
+
+    char options[ECL_MAX_STRING_LEN];
+    snprintf(options, sizeof(options), "-D WG=%zu -D BINS=%zu", grid.wg, bins);
+
+    uint32_t count = n;
+    uint32_t chunk = grid.chunk;
+
+    EclFrameArg_t args[] = {
+        {ECL_ARG_BUFFER, in},
+        {ECL_ARG_BUFFER, out},
+        {ECL_ARG_VAR, &count, sizeof(uint32_t)},
+        {ECL_ARG_VAR, &chunk, sizeof(uint32_t)}
+    };
+    return _eclPrimLaunch(&prims->_histProg, &prims->_hist, options, args, 4, grid.groups, grid.wg, comp, exec);
+}
+
+// items with flag 1 are packed to out, their number is written to count, flags are 0 or 1
+EclError_t eclComputerCompact(EclPrimitives_t* prims, EclBuffer_t* in, EclBuffer_t* flags, EclBuffer_t* out, EclBuffer_t* count, const EclComputer_t* comp, EclComputerExec_t exec) {
+    size_t n = in->size / sizeof(uint32_t);
+    if(flags->size < n * sizeof(uint32_t) || out->size < n * sizeof(uint32_t) || count->size < sizeof(uint32_t) || n > UINT32_MAX) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    if(_eclIsHost(comp)) {
+        uint32_t packed = 0;
+        for(size_t i = 0; i < n; i++) {
+            if(((uint32_t*)flags->data)[i]) ((uint32_t*)out->data)[packed++] = ((uint32_t*)in->data)[i];
+        }
+
+        *(uint32_t*)count->data = packed;
+        return ECL_ERROR_OK;
+    }
+
+    _eclPrimInit(prims);
+    _EclPrimGrid_t grid = _eclPrimGrid(comp, n);
+
+    EclError_t err = _eclPrimOutput(count, comp);
+    if(err != ECL_ERROR_OK) return err;
+    if(!n) return _eclPrimZero(prims, count, 1, grid.wg, comp, exec);
+
+    err = _eclPrimOutput(out, comp);
+    if(err != ECL_ERROR_OK) return err;
+
+    err = _eclPrimTemp(&prims->_tmp, n * sizeof(uint32_t), comp);
+    if(err != ECL_ERROR_OK) return err;
+
+    char options[ECL_MAX_STRING_LEN];
+    _eclPrimOptions(ECL_TYPE_UINT, ECL_OP_SUM, grid.wg, options, sizeof(options));
+
+    // positions are exclusive sums of flags
+    err = _eclPrimScan(prims, options, grid, true, flags, &prims->_tmp, n, comp, ECL_EXEC_ASYNC);
+    if(err != ECL_ERROR_OK) return err;
+
+    uint32_t items = n;
+    EclFrameArg_t args[] = {
+        {ECL_ARG_BUFFER, in},
+        {ECL_ARG_BUFFER, flags},
+        {ECL_ARG_BUFFER, &prims->_tmp},
+        {ECL_ARG_BUFFER, out},
+        {ECL_ARG_BUFFER, count},
+        {ECL_ARG_VAR, &items, sizeof(uint32_t)}
+    };
+    return _eclPrimLaunch(&prims->_sortProg, &prims->_compact, options, args, 6, (n + grid.wg - 1) / grid.wg, grid.wg, comp, exec);
+}
+
+EclError_t eclPrimitivesClear(EclPrimitives_t* prims) {
+    EclProgram_t* progs[] = {&prims->_scanProg, &prims->_sortProg, &prims->_histProg};
+    for(size_t i = 0; i < 3; i++) {
+        EclError_t err = eclProgramClear(progs[i]);
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    EclKernel_t* kerns[] = {&prims->_reduce, &prims->_scan, &prims->_count, &prims->_scatter, &prims->_compact, &prims->_zero, &prims->_hist};
+    for(size_t i = 0; i < 7; i++) {
+        EclError_t err = eclKernelClear(kerns[i]);
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    EclBuffer_t* bufs[] = {&prims->_sums, &prims->_counts, &prims->_tmp};
+    for(size_t i = 0; i < 3; i++) {
+        EclError_t err = eclBufferClear(bufs[i]);
+        if(err != ECL_ERROR_OK) return err;
+    }
+
+    memset(prims, 0, sizeof(EclPrimitives_t));
+    return ECL_ERROR_OK;
+}
+
+// names become kernel variables, names starting with _ are used by generated code
+bool _eclPipeName(const char* name, bool spaces) {
+    if(!name[0] || name[0] == '_' || (name[0] >= '0' && name[0] <= '9') || strlen(name) >= ECL_MAX_NAME_LEN) return false;
+
+    for(const char* c = name; *c; c++) {
+        bool word = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '_';
+        if(!word && !(spaces && *c == ' ')) return false;
+    }
+    return true;
+}
+
+_EclPipeStage_t* _eclPipeFind(EclPipeline_t* pipe, const char* name) {
+    for(size_t i = 0; i < pipe->_stagesSize; i++) {
+        _EclPipeStage_t* st = &pipe->_stages[i];
+        if(st->type != _ECL_PIPE_OUTPUT && !strcmp(st->name, name)) return st;
+    }
+    return NULL;
+}
+
+// new stage changes kernel, so it's generated and built again
+EclError_t _eclPipeAdd(EclPipeline_t* pipe, _EclPipeStageType_t type, const char* name, const char* ctype, const char* expr, EclFrameArg_t arg) {
+    if(pipe->_stagesSize >= ECL_MAX_ARRAY_SIZE || !_eclPipeName(name, false) || !_eclPipeName(ctype, true)) return ECL_ERROR_INVALID_PIPELINE;
+    if(type != _ECL_PIPE_OUTPUT && _eclPipeFind(pipe, name)) return ECL_ERROR_INVALID_PIPELINE;
+    if(expr && strlen(expr) >= ECL_MAX_STRING_LEN) return ECL_ERROR_INVALID_PIPELINE;
+
+    EclError_t err = eclProgramClear(&pipe->_prog);
+    if(err != ECL_ERROR_OK) return err;
+
+    err = eclKernelClear(&pipe->_kern);
+    if(err != ECL_ERROR_OK) return err;
+
+    pipe->_prog.src[0] = '\0';
+
+    _EclPipeStage_t* st = &pipe->_stages[pipe->_stagesSize++];
+    st->type = type;
+    strcpy(st->name, name);
+    strcpy(st->ctype, ctype);
+    strcpy(st->expr, expr ? expr : "");
+    st->arg = arg;
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclPipelineInput(EclPipeline_t* pipe, const char* name, const char* type, EclBuffer_t* buf) {
+    return _eclPipeAdd(pipe, _ECL_PIPE_INPUT, name, type, NULL, (EclFrameArg_t){ECL_ARG_BUFFER, buf});
+}
+
+// value is read on every grid, so it may change without rebuild
+EclError_t eclPipelineScalar(EclPipeline_t* pipe, const char* name, const char* type, void* value, size_t size) {
+    return _eclPipeAdd(pipe, _ECL_PIPE_SCALAR, name, type, NULL, (EclFrameArg_t){ECL_ARG_VAR, value, size});
+}
+
+EclError_t eclPipelineMap(EclPipeline_t* pipe, const char* name, const char* type, const char* expr) {
+    return _eclPipeAdd(pipe, _ECL_PIPE_MAP, name, type, expr, (EclFrameArg_t){});
+}
+
+EclError_t eclPipelineOutput(EclPipeline_t* pipe, const char* name, EclBuffer_t* buf) {
+    _EclPipeStage_t* src = _eclPipeFind(pipe, name);
+    if(!src) return ECL_ERROR_INVALID_PIPELINE;
+
+    return _eclPipeAdd(pipe, _ECL_PIPE_OUTPUT, name, src->ctype, NULL, (EclFrameArg_t){ECL_ARG_BUFFER, buf});
+}
+
+bool _eclPipePrint(char* out, size_t* len, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(out + *len, ECL_MAX_PROGRAM_LEN - *len, fmt, args);
+    va_end(args);
+
+    if(n < 0 || *len + n >= ECL_MAX_PROGRAM_LEN) return false;
+
+    *len += n;
+    return true;
+}
+
+// one work-item per item: load inputs, evaluate maps in order, store outputs
+EclError_t _eclPipeGenerate(EclPipeline_t* pipe) {
+    char* src = pipe->_prog.src;
+    size_t len = 0;
+    bool ok = _eclPipePrint(src, &len, "kernel void pipeline(");
+
+    const char* sep = "";
+    for(size_t i = 0; i < pipe->_stagesSize && ok; i++) {
+        _EclPipeStage_t* st = &pipe->_stages[i];
+
+        if(st->type == _ECL_PIPE_INPUT) ok = _eclPipePrint(src, &len, "%sglobal const %s* _a%zu", sep, st->ctype, i);
+        else if(st->type == _ECL_PIPE_OUTPUT) ok = _eclPipePrint(src, &len, "%sglobal %s* _a%zu", sep, st->ctype, i);
+        else if(st->type == _ECL_PIPE_SCALAR) ok = _eclPipePrint(src, &len, "%s%s %s", sep, st->ctype, st->name);
+        else continue;
+
+        sep = ",";
+    }
+    ok = ok && _eclPipePrint(src, &len, "){\nsize_t _i=get_global_id(0);\n");
+
+    for(size_t i = 0; i < pipe->_stagesSize && ok; i++) {
+        _EclPipeStage_t* st = &pipe->_stages[i];
 
-    return ECL_ERROR_OK;
-}
+        if(st->type == _ECL_PIPE_INPUT) ok = _eclPipePrint(src, &len, "%s %s=_a%zu[_i];\n", st->ctype, st->name, i);
+        else if(st->type == _ECL_PIPE_MAP) ok = _eclPipePrint(src, &len, "%s %s=(%s)(%s);\n", st->ctype, st->name, st->ctype, st->expr);
+        else if(st->type == _ECL_PIPE_OUTPUT) ok = _eclPipePrint(src, &len, "_a%zu[_i]=%s;\n", i, st->name);
+    }
+    ok = ok && _eclPipePrint(src, &len, "}\n");
 
-bool _eclCheckBuffer(EclBuffer_t* arg, const EclComputer_t* comp, cl_mem* out) {
-    for(size_t i = 0; i < arg->_bufSize; i++) {
-        if(arg->_buf[i]._ctx == comp->_ctx) {
-            if(out) *out = arg->_buf[i]._mem;
-            return true;
-        }
+    if(!ok) {
+        src[0] = '\0';
+        return ECL_ERROR_INVALID_PIPELINE;
     }
-    return false;
+    return ECL_ERROR_OK;
 }
 
-bool _eclCheckProgram(EclProgram_t* prog, const EclComputer_t* comp, cl_program* out) {
-    for(size_t i = 0; i < prog->_progSize; i++) {
-        if(prog->_prog[i]._ctx == comp->_ctx) {
-            if(out) *out = prog->_prog[i]._prog;
-            return true;
-        }
+EclError_t eclPipelineGrid(EclPipeline_t* pipe, size_t count, const EclComputer_t* comp, EclComputerExec_t exec) {
+    // generated code needs OpenCL compiler
+    if(_eclIsHost(comp)) return ECL_ERROR_NO_COMPILER;
+
+    if(!pipe->_prog.src[0]) {
+        EclError_t err = _eclPipeGenerate(pipe);
+        if(err != ECL_ERROR_OK) return err;
+        strcpy(pipe->_kern.name, "pipeline");
     }
-    return false;
-}
+    pipe->_prog.cache = pipe->cache;
 
-bool _eclCheckKernel(EclKernel_t* kern, cl_program prog, cl_kernel* out) {
-    for(size_t i = 0; i < kern->_kernSize; i++) {
-        if(kern->_kern[i]._prog == prog) {
-            if(out) *out = kern->_kern[i]._kern;
-            return true;
-        }
+    EclFrame_t frame = {.prog = &pipe->_prog, .kern = &pipe->_kern};
+    for(size_t i = 0; i < pipe->_stagesSize; i++) {
+        if(pipe->_stages[i].type != _ECL_PIPE_MAP) frame.args[frame.argsCount++] = pipe->_stages[i].arg;
     }
-    return false;
+
+    EclWorkSize_t global = {.dim = 1, .sizes = {count}};
+    return eclComputerGrid(&frame, global, (EclWorkSize_t){}, comp, exec);
 }
 
-EclError_t _eclCreateBuffer(EclBuffer_t* arg, const EclComputer_t* comp, cl_mem* out) {
-    // check buffer
-    if(_eclCheckBuffer(arg, comp, out)) return ECL_ERROR_OK;
+EclError_t eclPipelineClear(EclPipeline_t* pipe) {
+    EclError_t err = eclProgramClear(&pipe->_prog);
+    if(err != ECL_ERROR_OK) return err;
 
-    // create buffer
-    if(arg->_bufSize >= ECL_MAX_MAP_SIZE) return ECL_ERROR_ALLOCATE_BUFFER;
+    err = eclKernelClear(&pipe->_kern);
+    if(err != ECL_ERROR_OK) return err;
 
-    cl_int err;
-    _EclBufferMap_t* e = &arg->_buf[arg->_bufSize++];
-    e->_ctx = comp->_ctx;
-    e->_mem = clCreateBuffer(comp->_ctx, (cl_mem_flags)arg->access, arg->size, NULL, &err);
+    memset(pipe, 0, sizeof(EclPipeline_t));
+    return ECL_ERROR_OK;
+}
 
-    *out = e->_mem;
+EclError_t eclProfilerCollect(EclProfiler_t* prof) {
+    _eclLock(&prof->_lock);
+    for(size_t i = 0; i < prof->recordsSize; i++)
+        _eclProfileCollect(&prof->records[i], false);
 
-    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
-    if(err == CL_INVALID_BUFFER_SIZE || err == CL_MEM_OBJECT_ALLOCATION_FAILURE) return ECL_ERROR_ALLOCATE_BUFFER;
+    _eclProfileAdvance(prof);
+    _eclUnlock(&prof->_lock);
 
     return ECL_ERROR_OK;
 }
 
-EclError_t _eclCreateProgram(EclProgram_t* prog, const EclComputer_t* comp, cl_program* out) {
-    // check program
-    if(_eclCheckProgram(prog, comp, out)) return ECL_ERROR_OK;
+const char* _eclProfileOpName(EclProfileOp_t op) {
+    if(op == ECL_PROFILE_SEND) return "send";
+    if(op == ECL_PROFILE_GRID) return "grid";
+    return "receive";
+}
 
-    // create program
-    if(prog->_progSize >= ECL_MAX_MAP_SIZE) return ECL_ERROR_CREATE_PROGRAM;
+bool _eclProfileDone(const EclProfileRecord_t* r) {
+    return !r->_ev && r->end && r->end >= r->start;
+}
 
-    const char* src = prog->src;
-    size_t srcLen = strlen(prog->src);
+// aggregate by operation and kernel name
+EclError_t eclProfilerStats(EclProfiler_t* prof, EclProfileStats_t* out, size_t size, size_t* count) {
+    EclError_t err = eclProfilerCollect(prof);
+    if(err != ECL_ERROR_OK) return err;
 
-    cl_int err = 0;
+    *count = 0;
+    for(size_t i = 0; i < prof->recordsSize; i++) {
+        const EclProfileRecord_t* r = &prof->records[i];
+        if(!_eclProfileDone(r)) continue;
+
+        EclProfileStats_t* st = NULL;
+        for(size_t j = 0; j < *count; j++) {
+            if(out[j].op == r->op && !strcmp(out[j].name, r->name ? r->name : _eclProfileOpName(r->op))) {
+                st = &out[j];
+                break;
+            }
+        }
 
-    _EclProgramMap_t* e = &prog->_prog[prog->_progSize++];
-    e->_ctx = comp->_ctx;
-    e->_prog = clCreateProgramWithSource(comp->_ctx, 1, &src, &srcLen, &err);
+        if(!st) {
+            if(*count == size) continue;
 
-    *out = e->_prog;
+            st = &out[(*count)++];
+            memset(st, 0, sizeof(EclProfileStats_t));
 
-    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+            st->op = r->op;
+            strcpy(st->name, r->name ? r->name : _eclProfileOpName(r->op));
+        }
 
-    err = clBuildProgram(e->_prog, 0, NULL, NULL, NULL, NULL);
-    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
-    if(err == CL_COMPILER_NOT_AVAILABLE) return ECL_ERROR_NO_COMPILER;
-    if(err == CL_BUILD_PROGRAM_FAILURE) return ECL_ERROR_BUILD_PROGRAM;
+        double time = (double)(r->end - r->start);
+
+        st->min = st->count ? (time < st->min ? time : st->min) : time;
+        st->max = time > st->max ? time : st->max;
+        st->total += time;
+        st->wait += (double)(r->start - r->queued);
+        st->bytes += r->bytes;
+        st->count++;
+    }
 
     return ECL_ERROR_OK;
 }
 
-EclError_t _eclCreateKernel(EclKernel_t* kern, cl_program prog, cl_kernel* out) {
-    // check kernel
-    if(_eclCheckKernel(kern, prog, out)) return ECL_ERROR_OK;
+void _eclJsonString(FILE* f, const char* str) {
+    fputc('"', f);
+    for(; *str; str++) {
+        if(*str == '"' || *str == '\\') fputc('\\', f);
+        if((unsigned char)*str >= ' ') fputc(*str, f);
+    }
+    fputc('"', f);
+}
 
-    // create kernel
-    if(kern->_kernSize >= ECL_MAX_MAP_SIZE) return ECL_ERROR_CREATE_KERNEL;
+// chrome://tracing json, one process per device and one thread per operation type
+EclError_t eclProfilerExportTrace(EclProfiler_t* prof, const char* filename) {
+    EclError_t err = eclProfilerCollect(prof);
+    if(err != ECL_ERROR_OK) return err;
 
-    cl_int err = 0;
+    FILE* f = fopen(filename, "w");
+    if(!f) return ECL_ERROR_WRITE_FILE;
 
-    _EclKernelMap_t* e = &kern->_kern[kern->_kernSize++];
-    e->_prog = prog;
-    e->_kern = clCreateKernel(prog, kern->name, &err);
+    const EclDevice_t* devs[ECL_MAX_DEVICES_COUNT] = {};
+    size_t devsCount = 0;
 
-    *out = e->_kern;
+    // device clocks are not synchronized, time is relative to the earliest command
+    cl_ulong origin = 0;
+    for(size_t i = 0; i < prof->recordsSize; i++) {
+        const EclProfileRecord_t* r = &prof->records[i];
+        if(_eclProfileDone(r) && (!origin || r->queued < origin)) origin = r->queued;
+    }
 
-    if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
-    if(err == CL_INVALID_KERNEL_NAME) return ECL_ERROR_NO_KERNEL; 
+    fprintf(f, "{\"traceEvents\":[");
+
+    bool first = true;
+    for(size_t i = 0; i < prof->recordsSize; i++) {
+        const EclProfileRecord_t* r = &prof->records[i];
+        if(!_eclProfileDone(r)) continue;
+
+        size_t pid = 0;
+        while(pid < devsCount && devs[pid] != r->dev) pid++;
+
+        if(pid == devsCount && devsCount < ECL_MAX_DEVICES_COUNT) {
+            devs[devsCount++] = r->dev;
+
+            fprintf(f, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%zu,\"args\":{\"name\":", first ? "" : ",", pid);
+            _eclJsonString(f, r->dev->name);
+            fprintf(f, "}}");
+            for(size_t op = ECL_PROFILE_SEND; op <= ECL_PROFILE_RECEIVE; op++)
+                fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%zu,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}", pid, op, _eclProfileOpName((EclProfileOp_t)op));
+
+            first = false;
+        }
+
+        fprintf(f, "%s\n{\"name\":", first ? "" : ",");
+        _eclJsonString(f, r->name ? r->name : _eclProfileOpName(r->op));
+
+        fprintf(f, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%zu,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%zu,\"queued\":%.3f,\"submit\":%.3f}}",
+            _eclProfileOpName(r->op), pid, (int)r->op,
+            ((double)r->start - origin) * 1e-3, (double)(r->end - r->start) * 1e-3,
+            r->bytes, ((double)r->queued - origin) * 1e-3, ((double)r->submit - origin) * 1e-3
+        );
+
+        first = false;
+    }
+
+    fprintf(f, "\n]}\n");
+    if(fclose(f)) return ECL_ERROR_WRITE_FILE;
 
     return ECL_ERROR_OK;
 }
 
-EclError_t eclComputerSend(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec) {
+EclError_t eclProfilerClear(EclProfiler_t* prof) {
+    for(size_t i = 0; i < prof->recordsSize; i++) {
+        if(prof->records[i]._ev) clReleaseEvent(prof->records[i]._ev);
+    }
+
+    free(prof->records);
+    _eclMapClear(&prof->_names);
+
+    size_t capacity = prof->capacity;
+    memset(prof, 0, sizeof(EclProfiler_t));
+    prof->capacity = capacity;
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclComputerMap(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec) {
+    if(_eclIsHost(comp)) return ECL_ERROR_OK;
+
     cl_mem mem = 0;
     EclError_t err = _eclCreateBuffer(arg, comp, &mem);
     if(err != ECL_ERROR_OK) return err;
 
-    int16_t tmpErr = clEnqueueWriteBuffer(comp->_queue, mem, CL_FALSE, 0, arg->size, arg->data, 0, NULL, NULL);
-    if(tmpErr == CL_MEM_OBJECT_ALLOCATION_FAILURE) return ECL_ERROR_ALLOCATE_BUFFER;
+    return eclComputerReceive(arg, comp, exec);
+}
 
-    if(exec == ECL_EXEC_SYNC) {
-        err = eclComputerAwait(comp);
-        if(err != ECL_ERROR_OK) return err;
-    }
-    return ECL_ERROR_OK;
+// buffers of both slots take at most half of device memory, so frame's own buffers still fit
+size_t _eclStreamChunk(const EclStream_t* stream, const EclComputer_t* comp) {
+    size_t inStride = stream->in ? stream->inStride : 0;
+    size_t outStride = stream->out ? stream->outStride : 0;
+
+    // host uses data in place
+    if(_eclIsHost(comp) || inStride + outStride == 0) return stream->count;
+
+    size_t chunk = comp->dev->globalMem / 4 / (inStride + outStride);
+
+    size_t maxStride = inStride > outStride ? inStride : outStride;
+    if(comp->dev->maxAlloc / maxStride < chunk) chunk = comp->dev->maxAlloc / maxStride;
+
+    // whole work-groups in every chunk but last
+    size_t align = stream->axis < stream->local.dim && stream->local.sizes[stream->axis] ? stream->local.sizes[stream->axis] : 1;
+    chunk -= chunk % align;
+    if(chunk == 0) chunk = align;
+
+    return chunk < stream->count ? chunk : stream->count;
 }
 
-EclError_t eclComputerGrid(EclFrame_t* frame, EclWorkSize_t global, EclWorkSize_t local, const EclComputer_t* comp, EclComputerExec_t exec) {
-    // check program
-    cl_program prog = 0;
-    EclError_t err = _eclCreateProgram(frame->prog, comp, &prog);
-    if(err != ECL_ERROR_OK) return err;
+EclError_t eclComputerStream(EclStream_t* stream, const EclComputer_t* comp) {
+    EclFrame_t* frame = stream->frame;
+    if(stream->axis >= stream->global.dim) return ECL_ERROR_INVALID_ARG_SIZE;
 
-    // check kernel
-    cl_kernel kern = 0;
-    err = _eclCreateKernel(frame->kern, prog, &kern);
-    if(err != ECL_ERROR_OK) return err;
+    size_t chunk = stream->chunk ? stream->chunk : _eclStreamChunk(stream, comp);
+    if(chunk == 0) return stream->count ? ECL_ERROR_INVALID_ARG_SIZE : ECL_ERROR_OK;
 
-    // set args
-    cl_int tmpErr = 0;
+    // kernel has no items count, so every chunk including last one is made of whole work-groups
+    size_t align = stream->axis < stream->local.dim && stream->local.sizes[stream->axis] ? stream->local.sizes[stream->axis] : 1;
+    if(chunk % align || stream->count % align) return ECL_ERROR_INVALID_ARG_SIZE;
+    if((stream->in && stream->inArg >= frame->argsCount) || (stream->out && stream->outArg >= frame->argsCount)) return ECL_ERROR_INVALID_ARG_SIZE;
+
+    // double buffering: while chunk N computes, N + 1 is uploaded and N - 1 downloaded
+    EclBuffer_t in[2] = {};
+    EclBuffer_t out[2] = {};
+
+    EclFrameArg_t inArg = stream->in ? frame->args[stream->inArg] : (EclFrameArg_t){};
+    EclFrameArg_t outArg = stream->out ? frame->args[stream->outArg] : (EclFrameArg_t){};
+
+    EclWorkSize_t global = stream->global;
+    EclError_t err = ECL_ERROR_OK;
+
+    for(size_t i = 0; i * chunk < stream->count && err == ECL_ERROR_OK; i++) {
+        size_t slot = i % 2;
+        size_t first = i * chunk;
+        size_t count = stream->count - first < chunk ? stream->count - first : chunk;
+
+        // upload
+        if(stream->in) {
+            in[slot].data = (uint8_t*)stream->in + first * stream->inStride;
+            in[slot].size = count * stream->inStride;
+            in[slot].access = ECL_BUFFER_READ;
+
+            err = eclComputerSend(&in[slot], comp, ECL_EXEC_ASYNC);
+            if(err != ECL_ERROR_OK) break;
+
+            frame->args[stream->inArg] = (EclFrameArg_t){ECL_ARG_BUFFER, &in[slot]};
+        }
+
+        if(stream->out) {
+            out[slot].data = (uint8_t*)stream->out + first * stream->outStride;
+            out[slot].size = count * stream->outStride;
+            out[slot].access = ECL_BUFFER_WRITE;
 
-    for(size_t i = 0; i < frame->argsCount; i++) {
-        if(frame->args[i].type == ECL_ARG_BUFFER) {
             cl_mem mem = 0;
-            if(!_eclCheckBuffer((EclBuffer_t*)frame->args[i].arg, comp, &mem)) return ECL_ERROR_BUFFER_NOT_SENDED;
+            err = _eclCreateBuffer(&out[slot], comp, &mem);
+            if(err != ECL_ERROR_OK) break;
 
-            tmpErr = clSetKernelArg(kern, i, sizeof(cl_mem), &mem);
-        } else
-            tmpErr = clSetKernelArg(kern, i, frame->args[i].size, frame->args[i].arg);
+            frame->args[stream->outArg] = (EclFrameArg_t){ECL_ARG_BUFFER, &out[slot]};
+        }
 
-        if(tmpErr == CL_OUT_OF_HOST_MEMORY || tmpErr == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
-        if(tmpErr == CL_INVALID_ARG_SIZE) return ECL_ERROR_INVALID_ARG_SIZE;
+        // compute
+        size_t offset[ECL_MAX_WORKITEMS_DIMENSION] = {};
+        offset[stream->axis] = first;
+
+        global.sizes[stream->axis] = count;
+        err = _eclGrid(frame, stream->offset ? offset : NULL, global, stream->local, comp, ECL_EXEC_ASYNC, NULL, 0, NULL);
+        if(err != ECL_ERROR_OK) break;
+
+        // download
+        if(stream->out) err = eclComputerReceive(&out[slot], comp, ECL_EXEC_ASYNC);
     }
 
-    tmpErr = clEnqueueNDRangeKernel(comp->_queue, kern, global.dim, NULL, global.sizes, local.sizes, 0, NULL, NULL);
+    EclError_t awaitErr = eclComputerAwait(comp);
+    if(err == ECL_ERROR_OK) err = awaitErr;
 
-    if(exec == ECL_EXEC_SYNC) {
-        err = eclComputerAwait(comp);
-        if(err != ECL_ERROR_OK) return err;
+    // restore frame
+    if(stream->in) frame->args[stream->inArg] = inArg;
+    if(stream->out) frame->args[stream->outArg] = outArg;
+
+    for(size_t i = 0; i < 2; i++) {
+        eclBufferClear(&in[i]);
+        eclBufferClear(&out[i]);
     }
 
-    return ECL_ERROR_OK;
+    return err;
 }
 
-EclError_t eclComputerReceive(EclBuffer_t* arg, const EclComputer_t* comp, EclComputerExec_t exec) {
-    cl_mem mem = 0;
-    if(!_eclCheckBuffer(arg, comp, &mem)) return ECL_ERROR_BUFFER_NOT_SENDED;
+EclError_t eclFileMap(const char* filename, EclFile_t* file) {
+    int fd = open(filename, file->write ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if(fd < 0) return ECL_ERROR_MAP_FILE;
 
-    cl_int err;
-    out_of_memory_check(err, clEnqueueReadBuffer(comp->_queue, mem, CL_FALSE, 0, arg->size, arg->data, 0, NULL, NULL));
+    if(file->write && file->size && ftruncate(fd, file->size) != 0) {
+        close(fd);
+        return ECL_ERROR_MAP_FILE;
+    }
 
-    if(exec == ECL_EXEC_SYNC) {
-        EclError_t tmpErr = eclComputerAwait(comp);
-        if(tmpErr != ECL_ERROR_OK) return tmpErr;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return ECL_ERROR_MAP_FILE;
     }
 
+    // mapping keeps file open
+    void* data = mmap(NULL, st.st_size, file->write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(data == MAP_FAILED) return ECL_ERROR_MAP_FILE;
+
+    // streams walk files once from start to end
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    file->data = data;
+    file->size = st.st_size;
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclFileClear(EclFile_t* file) {
+    if(file->data && munmap(file->data, file->size) != 0) return ECL_ERROR_MAP_FILE;
+
+    file->data = NULL;
+    file->size = 0;
+    file->write = false;
+
     return ECL_ERROR_OK;
 }
 
 EclError_t eclComputerAwait(const EclComputer_t* comp) {
+    if(_eclIsHost(comp)) return ECL_ERROR_OK;
+
     cl_int err;
+    if(comp->_upload != comp->_queue) {
+        out_of_memory_check(err, clFinish(comp->_upload));
+    }
     out_of_memory_check(err, clFinish(comp->_queue));
+    if(comp->_download != comp->_queue) {
+        out_of_memory_check(err, clFinish(comp->_download));
+    }
 
     return ECL_ERROR_OK;
 }
 
 EclError_t eclComputerClear(EclComputer_t* comp) {
+    if(_eclIsHost(comp)) {
+        _eclHostPoolClear(comp->_host);
+
+        comp->_host = NULL;
+        comp->dev = NULL;
+
+        return ECL_ERROR_OK;
+    }
+
     cl_int err;
     out_of_memory_check(err, clReleaseContext(comp->_ctx));
+    if(comp->_upload != comp->_queue) {
+        out_of_memory_check(err, clReleaseCommandQueue(comp->_upload));
+    }
+    if(comp->_download != comp->_queue) {
+        out_of_memory_check(err, clReleaseCommandQueue(comp->_download));
+    }
     out_of_memory_check(err, clReleaseCommandQueue(comp->_queue));
 
     comp->_ctx = 0;
     comp->_queue = 0;
+    comp->_upload = 0;
+    comp->_download = 0;
     comp->dev = NULL;
 
     return ECL_ERROR_OK;
@@ -548,14 +4595,49 @@ EclError_t eclProgramLoad(const char* name, EclProgram_t* out) {
     return ECL_ERROR_OK;
 }
 
+EclError_t _eclOptionsDefine(char* opts, const char* name, const char* fmt, va_list args) {
+    char value[ECL_MAX_STRING_LEN];
+    vsnprintf(value, sizeof(value), fmt, args);
+
+    size_t len = strlen(opts);
+    int n = snprintf(opts + len, ECL_MAX_STRING_LEN - len, "%s-D %s=%s", len ? " " : "", name, value);
+
+    if(n < 0 || len + n >= ECL_MAX_STRING_LEN) {
+        opts[len] = '\0';
+        return ECL_ERROR_INVALID_OPTIONS;
+    }
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclProgramDefine(EclProgram_t* prog, const char* name, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    EclError_t err = _eclOptionsDefine(prog->options, name, fmt, args);
+    va_end(args);
+
+    return err;
+}
+
+EclError_t eclFrameDefine(EclFrame_t* frame, const char* name, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    EclError_t err = _eclOptionsDefine(frame->options, name, fmt, args);
+    va_end(args);
+
+    return err;
+}
+
 EclError_t eclProgramClear(EclProgram_t* prog) {
     cl_int err = 0;
     for(size_t i = 0; i < prog->_progSize; i++) {
-        out_of_memory_check(err, clReleaseProgram(prog->_prog[i]._prog));
-
-        prog->_prog[i]._ctx = 0;
-        prog->_prog[i]._prog = 0;
+        _EclProgramMap_t* e = (_EclProgramMap_t*)_eclMapAt(&prog->_prog, &prog->_progMap, i);
+        if(e->_prog) {
+            out_of_memory_check(err, clReleaseProgram(e->_prog));
+        }
     }
+    memset(&prog->_prog, 0, sizeof(_EclProgramMap_t));
+    _eclMapClear(&prog->_progMap);
     prog->_progSize = 0;
 
     return ECL_ERROR_OK;
@@ -564,59 +4646,330 @@ EclError_t eclProgramClear(EclProgram_t* prog) {
 EclError_t eclKernelClear(EclKernel_t* kern) {
     cl_int err = 0;
     for(size_t i = 0; i < kern->_kernSize; i++) {
-        out_of_memory_check(err, clReleaseKernel(kern->_kern[i]._kern));
-
-        kern->_kern[i]._prog = 0;
-        kern->_kern[i]._kern = 0;
+        _EclKernelMap_t* e = (_EclKernelMap_t*)_eclMapAt(&kern->_kern, &kern->_kernMap, i);
+        if(e->_kern) {
+            out_of_memory_check(err, clReleaseKernel(e->_kern));
+        }
     }
+    memset(&kern->_kern, 0, sizeof(_EclKernelMap_t));
+    _eclMapClear(&kern->_kernMap);
     kern->_kernSize = 0;
 
     return ECL_ERROR_OK;
 }
 
+// releases kernels of calling thread, e.g. before it exits, entries are reused by its next launches
+EclError_t eclKernelClearThread(EclKernel_t* kern) {
+    uintptr_t self = _eclThread();
+
+    for(size_t i = 0;; i++) {
+        _eclLock(&kern->_lock);
+        _EclKernelMap_t* e = i < kern->_kernSize ? (_EclKernelMap_t*)_eclMapAt(&kern->_kern, &kern->_kernMap, i) : NULL;
+        _eclUnlock(&kern->_lock);
+
+        if(!e) break;
+        if(e->_thread != self || !e->_kern) continue;
+
+        cl_int err;
+        out_of_memory_check(err, clReleaseKernel(e->_kern));
+        e->_kern = 0;
+    }
+
+    return ECL_ERROR_OK;
+}
+
 EclError_t eclBufferClear(EclBuffer_t* arg) {
     cl_int err = 0;
     for(size_t i = 0; i < arg->_bufSize; i++) {
-        out_of_memory_check(err, clReleaseMemObject(arg->_buf[i]._mem));
+        _EclBufferMap_t* e = (_EclBufferMap_t*)_eclMapAt(&arg->_buf, &arg->_bufMap, i);
 
-        arg->_buf[i]._ctx = 0;
-        arg->_buf[i]._mem = 0;
+        if(e->_mapped) {
+            out_of_memory_check(err, clEnqueueUnmapMemObject(e->_queue, e->_mem, e->_ptr, 0, NULL, NULL));
+        }
+        if(e->_pool) {
+            // region goes to free list with last event, so its next owner doesn't overwrite data still in use
+            _eclLock(&e->_pool->_lock);
+            EclError_t tmpErr = _eclPoolFree(e->_pool, e->_mem, e->_class, e->_size, (cl_mem_flags)arg->access, e->_ev);
+            _eclUnlock(&e->_pool->_lock);
+
+            if(tmpErr != ECL_ERROR_OK) return tmpErr;
+            continue;
+        }
+
+        if(e->_ev) {
+            out_of_memory_check(err, clReleaseEvent(e->_ev));
+        }
+        if(e->_mem) {
+            out_of_memory_check(err, clReleaseMemObject(e->_mem));
+        }
     }
+    memset(&arg->_buf, 0, sizeof(_EclBufferMap_t));
+    _eclMapClear(&arg->_bufMap);
     arg->_bufSize = 0;
 
     arg->data = NULL;
     arg->size = 0;
     arg->access = 0;
+    arg->memory = ECL_BUFFER_DEVICE;
 
     return ECL_ERROR_OK;
 }
 
-EclError_t _eclClearDevicesByType(EclDeviceType_t type, EclPlatform_t* platform) {
-    EclDevice_t* out = NULL;
-    size_t* outSize = NULL;
-    _eclGetDevicesArrayByType(type, platform, &out, &outSize);
+EclError_t eclPoolStats(const EclPool_t* pool, EclPoolStats_t* out) {
+    memset(out, 0, sizeof(EclPoolStats_t));
+
+    _EclLock_t* lock = (_EclLock_t*)&pool->_lock;
+    _eclLock(lock);
+    for(size_t i = 0; i < pool->_slabsSize; i++)
+        out->reserved += pool->_slabs[i]._size;
+
+    for(size_t c = 0; c < ECL_POOL_CLASSES; c++)
+        out->cached += pool->_free[c]._size * ((size_t)ECL_POOL_MIN_CLASS << c);
+
+    out->allocated = pool->_allocated;
+    out->inUse = pool->_inUse;
+
+    if(out->reserved) out->fragmentation = 1.0 - (double)out->inUse / out->reserved;
+    if(pool->_hits + pool->_misses) out->hitRate = (double)pool->_hits / (pool->_hits + pool->_misses);
+    _eclUnlock(lock);
+
+    return ECL_ERROR_OK;
+}
 
+EclError_t eclPoolClear(EclPool_t* pool) {
     cl_int err = 0;
-    for(size_t i = 0; i < *outSize; i++) {
-        out_of_memory_check(err, clReleaseDevice(out[i]._id));
 
-        memset(out + i, 0, sizeof(EclDevice_t));
+    for(size_t c = 0; c < ECL_POOL_CLASSES; c++) {
+        _EclPoolFreeList_t* list = &pool->_free[c];
+
+        for(size_t i = 0; i < list->_size; i++) {
+            if(list->_regions[i]._ev) {
+                out_of_memory_check(err, clReleaseEvent(list->_regions[i]._ev));
+            }
+            out_of_memory_check(err, clReleaseMemObject(list->_regions[i]._mem));
+        }
+        free(list->_regions);
+
+        list->_regions = NULL;
+        list->_size = 0;
+        list->_cap = 0;
+    }
+
+    for(size_t i = 0; i < pool->_slabsSize; i++) {
+        out_of_memory_check(err, clReleaseMemObject(pool->_slabs[i]._mem));
     }
-    *outSize = 0;
+    free(pool->_slabs);
+
+    pool->_slabs = NULL;
+    pool->_slabsSize = 0;
+    pool->_slabsCap = 0;
+
+    pool->_ctx = 0;
+    pool->_align = 0;
+    pool->_hits = 0;
+    pool->_misses = 0;
+    pool->_allocated = 0;
+    pool->_inUse = 0;
 
     return ECL_ERROR_OK;
 }
 
-EclError_t eclPlatformClear(EclPlatform_t* plat) {
-    EclError_t err = _eclClearDevicesByType(ECL_DEVICE_CPU, plat);
-    if(err != ECL_ERROR_OK) return err;
+EclError_t eclCompletionQueue(size_t capacity, EclCompletionQueue_t* out) {
+    memset(out, 0, sizeof(EclCompletionQueue_t));
+    out->fd = -1;
 
-    err = _eclClearDevicesByType(ECL_DEVICE_GPU, plat);
-    if(err != ECL_ERROR_OK) return err;
-    
-    err = _eclClearDevicesByType(ECL_DEVICE_ACCEL, plat);
+    // power of two, so position maps to slot by mask
+    size_t size = 1;
+    while(size < (capacity ? capacity : ECL_COMPLETIONS_SIZE)) size <<= 1;
+
+    out->_slots = malloc(size * sizeof(_EclCompletionSlot_t));
+    if(!out->_slots) return ECL_ERROR_OUT_OF_MEMORY;
+
+    for(size_t i = 0; i < size; i++)
+        atomic_init(&out->_slots[i]._seq, i);
+
+    out->_mask = size - 1;
+    atomic_init(&out->_head, 0);
+    atomic_init(&out->_inFlight, 0);
+    atomic_init(&out->_watching, 0);
+
+    out->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(out->fd < 0) {
+        free(out->_slots);
+        out->_slots = NULL;
+        return ECL_ERROR_CREATE_COMPLETIONS;
+    }
+
+    return ECL_ERROR_OK;
+}
+
+// ring always has room, watch reserves it
+void _eclCompletionPush(EclCompletionQueue_t* queue, void* user, cl_int status) {
+    size_t pos = atomic_load_explicit(&queue->_head, memory_order_relaxed);
+    _EclCompletionSlot_t* slot;
+
+    for(;;) {
+        slot = &queue->_slots[pos & queue->_mask];
+        size_t seq = atomic_load_explicit(&slot->_seq, memory_order_acquire);
+
+        // slot is free for this position, otherwise other producer took it
+        if(seq == pos) {
+            if(atomic_compare_exchange_weak_explicit(&queue->_head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        } else
+            pos = atomic_load_explicit(&queue->_head, memory_order_relaxed);
+    }
+
+    slot->_val.user = user;
+    slot->_val.status = status;
+    atomic_store_explicit(&slot->_seq, pos + 1, memory_order_release);
+
+    uint64_t one = 1;
+    ssize_t written = write(queue->fd, &one, sizeof(uint64_t));
+    (void)written; // counter overflow only, fd is readable anyway
+}
+
+typedef struct {
+    EclCompletionQueue_t* queue;
+    void* user;
+} _EclCompletionWatch_t;
+
+void CL_CALLBACK _eclCompletionCallback(cl_event ev, cl_int status, void* data) {
+    _EclCompletionWatch_t* watch = (_EclCompletionWatch_t*)data;
+    EclCompletionQueue_t* queue = watch->queue;
+
+    _eclCompletionPush(queue, watch->user, status);
+    free(watch);
+    clReleaseEvent(ev);
+
+    atomic_fetch_sub_explicit(&queue->_watching, 1, memory_order_release);
+}
+
+EclError_t eclCompletionWatch(EclCompletionQueue_t* queue, const EclEvent_t* event, void* user) {
+    if(atomic_fetch_add_explicit(&queue->_inFlight, 1, memory_order_relaxed) > queue->_mask) {
+        atomic_fetch_sub_explicit(&queue->_inFlight, 1, memory_order_relaxed);
+        return ECL_ERROR_COMPLETIONS_FULL;
+    }
+
+    // synchronous commands and host grids have no event, they are done already
+    if(!event->_ev) {
+        _eclCompletionPush(queue, user, CL_COMPLETE);
+        return ECL_ERROR_OK;
+    }
+
+    _EclCompletionWatch_t* watch = malloc(sizeof(_EclCompletionWatch_t));
+    if(!watch) {
+        atomic_fetch_sub_explicit(&queue->_inFlight, 1, memory_order_relaxed);
+        return ECL_ERROR_OUT_OF_MEMORY;
+    }
+
+    watch->queue = queue;
+    watch->user = user;
+
+    // callback owns event reference, so caller may clear its event right away
+    atomic_fetch_add_explicit(&queue->_watching, 1, memory_order_relaxed);
+    cl_int err = clRetainEvent(event->_ev);
+    bool retained = err == CL_SUCCESS;
+    if(retained) err = clSetEventCallback(event->_ev, CL_COMPLETE, _eclCompletionCallback, watch);
+
+    if(err != CL_SUCCESS) {
+        if(retained) clReleaseEvent(event->_ev);
+        free(watch);
+
+        atomic_fetch_sub_explicit(&queue->_watching, 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&queue->_inFlight, 1, memory_order_relaxed);
+
+        if(err == CL_OUT_OF_HOST_MEMORY || err == CL_OUT_OF_RESOURCES) return ECL_ERROR_OUT_OF_MEMORY;
+        return ECL_ERROR_INVALID_EVENTS;
+    }
+
+    // in-order queue isn't flushed by async commands, callback would never fire
+    cl_command_queue cmdQueue = 0;
+    if(clGetEventInfo(event->_ev, CL_EVENT_COMMAND_QUEUE, sizeof(cl_command_queue), &cmdQueue, NULL) == CL_SUCCESS && cmdQueue) clFlush(cmdQueue);
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclCompletionPoll(EclCompletionQueue_t* queue, EclCompletion_t* out, size_t size, size_t* count) {
+    // reset fd before popping, pushes after it signal again
+    uint64_t value = 0;
+    ssize_t got = read(queue->fd, &value, sizeof(uint64_t));
+    (void)got; // EAGAIN when nothing was signaled
+
+    size_t n = 0;
+    while(n < size) {
+        _EclCompletionSlot_t* slot = &queue->_slots[queue->_tail & queue->_mask];
+        if(atomic_load_explicit(&slot->_seq, memory_order_acquire) != queue->_tail + 1) break;
+
+        out[n++] = slot->_val;
+        atomic_store_explicit(&slot->_seq, queue->_tail + queue->_mask + 1, memory_order_release);
+        queue->_tail++;
+    }
+    atomic_fetch_sub_explicit(&queue->_inFlight, n, memory_order_relaxed);
+
+    // out was too small, keep fd readable for level-triggered pollers
+    _EclCompletionSlot_t* slot = &queue->_slots[queue->_tail & queue->_mask];
+    if(n == size && atomic_load_explicit(&slot->_seq, memory_order_acquire) == queue->_tail + 1) {
+        uint64_t one = 1;
+        ssize_t written = write(queue->fd, &one, sizeof(uint64_t));
+        (void)written;
+    }
+
+    if(count) *count = n;
+    return ECL_ERROR_OK;
+}
+
+// waits for pending callbacks, their completions are dropped
+EclError_t eclCompletionQueueClear(EclCompletionQueue_t* queue) {
+    if(!queue->_slots) return ECL_ERROR_OK;
+
+    while(atomic_load_explicit(&queue->_watching, memory_order_acquire))
+        sched_yield();
+
+    if(queue->fd >= 0) close(queue->fd);
+    free(queue->_slots);
+
+    queue->fd = -1;
+    queue->_slots = NULL;
+    queue->_mask = 0;
+    queue->_tail = 0;
+    atomic_store(&queue->_head, 0);
+    atomic_store(&queue->_inFlight, 0);
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclEventAwait(const EclEvent_t* event) {
+    return eclEventsAwait(event, 1);
+}
+
+EclError_t eclEventsAwait(const EclEvent_t* events, size_t count) {
+    _EclWaitList_t waitList;
+    EclError_t err = _eclWaitList(events, count, &waitList);
     if(err != ECL_ERROR_OK) return err;
 
+    if(waitList.size == 0) return ECL_ERROR_OK;
+
+    cl_int tmpErr;
+    out_of_memory_check(tmpErr, clWaitForEvents(waitList.size, waitList.list));
+    if(tmpErr != CL_SUCCESS) return ECL_ERROR_INVALID_EVENTS;
+
+    return ECL_ERROR_OK;
+}
+
+EclError_t eclEventClear(EclEvent_t* event) {
+    if(!event->_ev) return ECL_ERROR_OK;
+
+    cl_int err;
+    out_of_memory_check(err, clReleaseEvent(event->_ev));
+    event->_ev = 0;
+
+    return ECL_ERROR_OK;
+}
+
+// devices stay in process-wide registry, so computers may outlive platform
+EclError_t eclPlatformClear(EclPlatform_t* plat) {
+    memset(plat, 0, sizeof(EclPlatform_t));
+
     return ECL_ERROR_OK;
 }
 
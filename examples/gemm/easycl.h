@@ -0,0 +1 @@
+../../easycl.h
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <time.h>
+#include "easycl.h"
+
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// runs frame a few times, returns GFLOPS
+double measure(EclFrame_t* frame, uint32_t n, EclWorkSize_t local, const EclComputer_t* gpu) {
+    EclWorkSize_t global = {.dim = 2, .sizes = {n, n}};
+
+    // warm up, builds program
+    EclError_t err = eclComputerGrid(frame, global, local, gpu, ECL_EXEC_SYNC);
+    if(err != ECL_ERROR_OK) {
+        fprintf(stderr, "%s failed: %d\n", frame->kern->name, err);
+        return 0;
+    }
+
+    size_t repeats = 10;
+
+    double start = now();
+    for(size_t i = 0; i < repeats; i++)
+        eclComputerGrid(frame, global, local, gpu, ECL_EXEC_ASYNC);
+    eclComputerAwait(gpu);
+    double time = (now() - start) / repeats;
+
+    return 2.0 * n * n * n / time * 1e-9;
+}
+
+int main() {
+    uint32_t n = 1024;
+    uint32_t ts = 16;
+
+    float* a = malloc(n * n * sizeof(float));
+    float* b = malloc(n * n * sizeof(float));
+    float* c = malloc(n * n * sizeof(float));
+
+    for(size_t i = 0; i < n * n; i++) {
+        a[i] = (float)(i % 7) / 7;
+        b[i] = (float)(i % 5) / 5;
+    }
+
+    // setup program and kernels
+    EclProgram_t prog = {};
+    eclProgramLoad("main.cl", &prog);
+
+    EclKernel_t naive = {.name = "gemm_naive"};
+    EclKernel_t tiled = {.name = "gemm_tiled"};
+
+    // get platform, setup the computer
+    EclPlatform_t plat = {};
+    eclGetPlatform(0, &plat);
+
+    EclComputer_t gpu = {};
+    eclComputer(0, ECL_DEVICE_GPU, &plat, &gpu);
+
+    // setup data containers
+    EclBuffer_t aBuf = {.data = a, .size = n * n * sizeof(float), .access = ECL_BUFFER_READ};
+    EclBuffer_t bBuf = {.data = b, .size = n * n * sizeof(float), .access = ECL_BUFFER_READ};
+    EclBuffer_t cBuf = {.data = c, .size = n * n * sizeof(float), .access = ECL_BUFFER_WRITE};
+
+    // setup compute frames, tiles are local memory of one float per work-item
+    EclFrame_t naiveFrame = {
+        .prog = &prog,
+        .kern = &naive,
+        .args = {
+            {ECL_ARG_BUFFER, &aBuf},
+            {ECL_ARG_BUFFER, &bBuf},
+            {ECL_ARG_BUFFER, &cBuf},
+            {ECL_ARG_VAR, &n, sizeof(uint32_t)}
+        },
+        .argsCount = 4
+    };
+
+    EclFrame_t tiledFrame = {
+        .prog = &prog,
+        .kern = &tiled,
+        .args = {
+            {ECL_ARG_BUFFER, &aBuf},
+            {ECL_ARG_BUFFER, &bBuf},
+            {ECL_ARG_BUFFER, &cBuf},
+            {ECL_ARG_VAR, &n, sizeof(uint32_t)},
+            {ECL_ARG_LOCAL_ITEMS, NULL, sizeof(float)},
+            {ECL_ARG_LOCAL_ITEMS, NULL, sizeof(float)}
+        },
+        .argsCount = 6
+    };
+    eclFrameDefine(&tiledFrame, "TS", "%u", ts);
+
+    eclComputerSend(&aBuf, &gpu, ECL_EXEC_SYNC);
+    eclComputerSend(&bBuf, &gpu, ECL_EXEC_SYNC);
+    eclComputerSend(&cBuf, &gpu, ECL_EXEC_SYNC);
+
+    // compute
+    EclWorkSize_t local = {.dim = 2, .sizes = {ts, ts}};
+
+    double naiveFlops = measure(&naiveFrame, n, local, &gpu);
+    double tiledFlops = measure(&tiledFrame, n, local, &gpu);
+
+    eclComputerReceive(&cBuf, &gpu, ECL_EXEC_SYNC);
+
+    // check a few values against cpu
+    float maxErr = 0;
+    for(size_t i = 0; i < n * n; i += n + 1) {
+        size_t row = i / n;
+        size_t col = i % n;
+
+        float sum = 0;
+        for(size_t k = 0; k < n; k++)
+            sum += a[row * n + k] * b[k * n + col];
+
+        float err = sum > c[i] ? sum - c[i] : c[i] - sum;
+        if(err > maxErr) maxErr = err;
+    }
+
+    // output
+    printf("naive: %.2f GFLOPS\n", naiveFlops);
+    printf("tiled: %.2f GFLOPS\n", tiledFlops);
+    printf("max error: %f\n", maxErr);
+
+    // clean resources
+    eclBufferClear(&aBuf);
+    eclBufferClear(&bBuf);
+    eclBufferClear(&cBuf);
+
+    eclComputerClear(&gpu);
+    eclPlatformClear(&plat);
+
+    eclKernelClear(&naive);
+    eclKernelClear(&tiled);
+    eclProgramClear(&prog);
+
+    free(a);
+    free(b);
+    free(c);
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+// TS may be defined at build time, must match work-group size
+#ifndef TS
+#define TS 16
+#endif
+
+// c = a * b, all matrices are n x n, row major
+kernel void gemm_naive(global const float* a, global const float* b, global float* c, uint n){
+    uint col = get_global_id(0);
+    uint row = get_global_id(1);
+
+    float sum = 0;
+    for(uint k = 0; k < n; k++)
+        sum += a[row * n + k] * b[k * n + col];
+
+    c[row * n + col] = sum;
+}
+
+// each work-group loads TS x TS tiles of a and b into local memory, so every value is read from global memory n / TS times instead of n
+kernel void gemm_tiled(global const float* a, global const float* b, global float* c, uint n, local float* tileA, local float* tileB){
+    uint x = get_local_id(0);
+    uint y = get_local_id(1);
+
+    uint col = get_global_id(0);
+    uint row = get_global_id(1);
+
+    float sum = 0;
+
+    for(uint t = 0; t < n; t += TS) {
+        tileA[y * TS + x] = a[row * n + t + x];
+        tileB[y * TS + x] = b[(t + y) * n + col];
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for(uint k = 0; k < TS; k++)
+            sum += tileA[y * TS + k] * tileB[k * TS + x];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    c[row * n + col] = sum;
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "easycl.h"
+#include "mandelbrot.h"
 
 
 void save_ppm(const char* filename, const uint8_t* data, size_t w, size_t h) {
@@ -13,35 +14,43 @@ void save_ppm(const char* filename, const uint8_t* data, size_t w, size_t h) {
     fclose(f);
 }
 
-void mandelbrot_cpu(uint8_t* data, uint32_t w, uint32_t h, float px, float py, float mag, uint32_t maxIter) {
-    float aspect = w / h;
+// same as kernel, runs on host threads
+void mandelbrot_host(const EclWorkItem_t* item, void* const* args) {
+    uint8_t* data = (uint8_t*)args[0];
+    uint32_t w = *(uint32_t*)args[1];
+    uint32_t h = *(uint32_t*)args[2];
+    float px = *(float*)args[3];
+    float py = *(float*)args[4];
+    float mag = *(float*)args[5];
+    uint32_t maxIter = *(uint32_t*)args[6];
 
-    for(int x = 0; x < w; x++) {
-        for(int y = 0; y < h; y++) {
-            float i = ((float)x - w / 2) / (mag * w / 4) - px;
-            float j = ((float)y - h / 2) / (mag * h * aspect / 4) - py;
+    float aspect = w / h;
 
-            float oldI = i;
-            float oldJ = j;
+    size_t x = item->global[0];
+    size_t y = item->global[1];
 
-            uint32_t k = 0;
+    float i = ((float)x - w / 2) / (mag * w / 4) - px;
+    float j = ((float)y - h / 2) / (mag * h * aspect / 4) - py;
 
-            for(; k < maxIter; k++) {
-                float a = i * i - j * j;
-                float b = 2 * i * j;
-                i = a + oldI;
-                j = b + oldJ;
+    float oldI = i;
+    float oldJ = j;
 
-                if(i * i + j * j > 4) break;
-            }
+    uint32_t k = 0;
 
-            uint32_t value = 255 * k / maxIter;
+    for(; k < maxIter; k++) {
+        float a = i * i - j * j;
+        float b = 2 * i * j;
+        i = a + oldI;
+        j = b + oldJ;
 
-            data[3 * (x + w * y)] = value;
-            data[3 * (x + w * y) + 1] = value;
-            data[3 * (x + w * y) + 2] = value;
-        }
+        if(i * i + j * j > 4) break;
     }
+
+    uint32_t value = 255 * k / maxIter;
+
+    data[3 * (x + w * y)] = value;
+    data[3 * (x + w * y) + 1] = value;
+    data[3 * (x + w * y) + 2] = value;
 }
 
 int main() {
@@ -66,7 +75,7 @@ int main() {
     EclProgram_t prog = {};
     eclProgramLoad("main.cl", &prog);
 
-    EclKernel_t kern = {.name = "mandelbrot"};
+    EclKernel_t kern = {.name = "mandelbrot", .host = mandelbrot_host};
 
     // get platform, setup the computer
     EclPlatform_t plat = {};
@@ -98,15 +107,47 @@ int main() {
         .argsCount = 7
     };
 
+    // specialize kernel for the image size and iterations count
+    eclFrameDefine(&frame, "W", "%u", w);
+    eclFrameDefine(&frame, "H", "%u", h);
+    eclFrameDefine(&frame, "MAX_ITER", "%u", maxIter);
+
     // compute
+    EclWorkSize_t global = {.dim = 2, .sizes = {w, h}};
+    EclWorkSize_t local = {};
+
     eclComputerSend(&dataBuf, &gpu, ECL_EXEC_SYNC);
-    eclComputerGrid(&frame, (EclWorkSize_t){.dim = 2, .sizes={w, h}}, (EclWorkSize_t){.dim = 2, .sizes={256, 1}}, &gpu, ECL_EXEC_SYNC);
+
+    // pick the fastest work-group size once, next runs read it from file
+    // tuning runs every candidate, so it's done on a band of rows instead of the whole frame
+    EclTuner_t tuner = {.file = "tune.txt"};
+    EclWorkSize_t tuneGlobal = {.dim = 2, .sizes = {w, 256}};
+
+    EclError_t err = eclComputerTune(&frame, tuneGlobal, &gpu, &tuner, &local);
+    if(err != ECL_ERROR_OK) {
+        fprintf(stderr, "tuning failed: %d, using default work-group size\n", err);
+        local = (EclWorkSize_t){};
+    }
+
+    eclComputerGrid(&frame, global, local, &gpu, ECL_EXEC_SYNC);
     eclComputerReceive(&dataBuf, &gpu, ECL_EXEC_SYNC);
 
     // output
     save_ppm("out_gpu.ppm", data, w, h);
 
+    // host threads, same frame without OpenCL
+    memset(data, 0, w * h * 3 * sizeof(uint8_t));
+
+    EclComputer_t host = {};
+    eclComputer(0, ECL_DEVICE_HOST, NULL, &host);
+
+    eclComputerGrid(&frame, global, (EclWorkSize_t){}, &host, ECL_EXEC_SYNC);
+    save_ppm("out_host.ppm", data, w, h);
+
+    eclComputerClear(&host);
+
     // clean resources
+    eclTunerClear(&tuner);
     eclBufferClear(&dataBuf);
 
     eclComputerClear(&gpu);
@@ -1,18 +1,31 @@
+// W, H and MAX_ITER may be defined at build time to specialize the kernel
+#ifndef W
+#define W w
+#endif
+
+#ifndef H
+#define H h
+#endif
+
+#ifndef MAX_ITER
+#define MAX_ITER maxIter
+#endif
+
 kernel void mandelbrot(global uchar* data, uint w, uint h, float px, float py, float mag, uint maxIter){
-    float aspect = w / h;
+    float aspect = W / H;
 
     uint x = get_global_id(0);
     uint y = get_global_id(1);
 
-    float i = ((float)x - w / 2) / (mag * w / 4) - px;
-    float j = ((float)y - h / 2) / (mag * h * aspect / 4) - py;
+    float i = ((float)x - W / 2) / (mag * W / 4) - px;
+    float j = ((float)y - H / 2) / (mag * H * aspect / 4) - py;
 
     float oldI = i;
     float oldJ = j;
 
     uint k = 0;
 
-    for(; k < maxIter; k++) {
+    for(; k < MAX_ITER; k++) {
         float a = i * i - j * j;
         float b = 2 * i * j;
         i = a + oldI;
@@ -21,9 +34,9 @@ kernel void mandelbrot(global uchar* data, uint w, uint h, float px, float py, f
         if(i * i + j * j > 4) break;
     }
 
-    uint value = 255 * k / maxIter;
+    uint value = 255 * k / MAX_ITER;
 
-    data[3 * (x + w * y)] = value;
-    data[3 * (x + w * y) + 1] = value;
-    data[3 * (x + w * y) + 2] = value;
+    data[3 * (x + W * y)] = value;
+    data[3 * (x + W * y) + 1] = value;
+    data[3 * (x + W * y) + 2] = value;
 }
@@ -0,0 +1,38 @@
+#ifndef _MANDELBROT_H_
+#define _MANDELBROT_H_
+
+#include <stdint.h>
+
+// scalar reference, shared with benchmark
+void mandelbrot_cpu(uint8_t* data, uint32_t w, uint32_t h, float px, float py, float mag, uint32_t maxIter) {
+    float aspect = w / h;
+
+    for(int x = 0; x < w; x++) {
+        for(int y = 0; y < h; y++) {
+            float i = ((float)x - w / 2) / (mag * w / 4) - px;
+            float j = ((float)y - h / 2) / (mag * h * aspect / 4) - py;
+
+            float oldI = i;
+            float oldJ = j;
+
+            uint32_t k = 0;
+
+            for(; k < maxIter; k++) {
+                float a = i * i - j * j;
+                float b = 2 * i * j;
+                i = a + oldI;
+                j = b + oldJ;
+
+                if(i * i + j * j > 4) break;
+            }
+
+            uint32_t value = 255 * k / maxIter;
+
+            data[3 * (x + w * y)] = value;
+            data[3 * (x + w * y) + 1] = value;
+            data[3 * (x + w * y) + 2] = value;
+        }
+    }
+}
+
+#endif // _MANDELBROT_H_
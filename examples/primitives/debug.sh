@@ -0,0 +1,3 @@
+#!/bin/bash
+
+gcc -g -lOpenCL -Wall -Werror main.c -o a.out
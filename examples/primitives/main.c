@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include "easycl.h"
+
+#define N (1 << 20)
+#define BINS 256
+
+typedef struct {
+    float total;
+    uint32_t offsets[N];
+    uint32_t keys[N];
+    uint32_t hist[BINS];
+    uint32_t selected[N];
+    uint32_t selectedCount;
+} Results_t;
+
+// runs every primitive, only inputs are sent, results are received at the end
+EclError_t run(float* values, uint32_t* counts, uint32_t* ids, uint32_t* flags, const EclComputer_t* comp, Results_t* out) {
+    // sort is in place, so it gets a copy
+    memcpy(out->keys, ids, N * sizeof(uint32_t));
+
+    EclBuffer_t valuesBuf = {.data = values, .size = N * sizeof(float), .access = ECL_BUFFER_READ};
+    EclBuffer_t countsBuf = {.data = counts, .size = N * sizeof(uint32_t), .access = ECL_BUFFER_READ};
+    EclBuffer_t idsBuf = {.data = ids, .size = N * sizeof(uint32_t), .access = ECL_BUFFER_READ};
+    EclBuffer_t flagsBuf = {.data = flags, .size = N * sizeof(uint32_t), .access = ECL_BUFFER_READ};
+    EclBuffer_t keysBuf = {.data = out->keys, .size = N * sizeof(uint32_t), .access = ECL_BUFFER_READ_WRITE};
+
+    EclBuffer_t totalBuf = {.data = &out->total, .size = sizeof(float), .access = ECL_BUFFER_WRITE};
+    EclBuffer_t offsetsBuf = {.data = out->offsets, .size = N * sizeof(uint32_t), .access = ECL_BUFFER_WRITE};
+    EclBuffer_t histBuf = {.data = out->hist, .size = BINS * sizeof(uint32_t), .access = ECL_BUFFER_WRITE};
+    EclBuffer_t selectedBuf = {.data = out->selected, .size = N * sizeof(uint32_t), .access = ECL_BUFFER_WRITE};
+    EclBuffer_t selectedCountBuf = {.data = &out->selectedCount, .size = sizeof(uint32_t), .access = ECL_BUFFER_WRITE};
+
+    EclPrimitives_t prims = {};
+
+    EclError_t err = eclComputerSend(&valuesBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerSend(&countsBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerSend(&idsBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerSend(&flagsBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerSend(&keysBuf, comp, ECL_EXEC_ASYNC);
+
+    if(err == ECL_ERROR_OK) err = eclComputerReduce(&prims, ECL_TYPE_FLOAT, ECL_OP_SUM, &valuesBuf, &totalBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerScan(&prims, ECL_TYPE_UINT, ECL_OP_SUM, true, &countsBuf, &offsetsBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerSort(&prims, &keysBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerHistogram(&prims, &idsBuf, BINS, &histBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerCompact(&prims, &idsBuf, &flagsBuf, &selectedBuf, &selectedCountBuf, comp, ECL_EXEC_SYNC);
+
+    if(err == ECL_ERROR_OK) err = eclComputerReceive(&totalBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerReceive(&offsetsBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerReceive(&keysBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerReceive(&histBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerReceive(&selectedBuf, comp, ECL_EXEC_ASYNC);
+    if(err == ECL_ERROR_OK) err = eclComputerReceive(&selectedCountBuf, comp, ECL_EXEC_SYNC);
+
+    // clean resources
+    eclPrimitivesClear(&prims);
+
+    eclBufferClear(&valuesBuf);
+    eclBufferClear(&countsBuf);
+    eclBufferClear(&idsBuf);
+    eclBufferClear(&flagsBuf);
+    eclBufferClear(&keysBuf);
+
+    eclBufferClear(&totalBuf);
+    eclBufferClear(&offsetsBuf);
+    eclBufferClear(&histBuf);
+    eclBufferClear(&selectedBuf);
+    eclBufferClear(&selectedCountBuf);
+
+    return err;
+}
+
+int main() {
+    // get platform, setup the computers
+    EclPlatform_t plat = {};
+    eclGetPlatform(0, &plat);
+
+    EclComputer_t gpu = {};
+    if(eclComputer(0, ECL_DEVICE_GPU, &plat, &gpu) != ECL_ERROR_OK) {
+        fprintf(stderr, "no gpu\n");
+        return 1;
+    }
+
+    EclComputer_t host = {};
+    eclComputer(0, ECL_DEVICE_HOST, NULL, &host);
+
+    float* values = malloc(N * sizeof(float));
+    uint32_t* counts = malloc(N * sizeof(uint32_t));
+    uint32_t* ids = malloc(N * sizeof(uint32_t));
+    uint32_t* flags = malloc(N * sizeof(uint32_t));
+
+    // ids above BINS are skipped by histogram
+    for(uint32_t i = 0; i < N; i++) {
+        values[i] = (float)(i % 100) / 100;
+        counts[i] = i % 4;
+        ids[i] = (i * 2654435761u) % (BINS + 16);
+        flags[i] = (i % 3) == 0;
+    }
+
+    Results_t* gpuRes = malloc(sizeof(Results_t));
+    Results_t* hostRes = malloc(sizeof(Results_t));
+
+    // compute on both, host is the reference
+    EclError_t err = run(values, counts, ids, flags, &gpu, gpuRes);
+    if(err != ECL_ERROR_OK) fprintf(stderr, "gpu failed: %d\n", err);
+
+    EclError_t hostErr = run(values, counts, ids, flags, &host, hostRes);
+    if(hostErr != ECL_ERROR_OK) fprintf(stderr, "host failed: %d\n", hostErr);
+
+    // compare
+    size_t bad = 0;
+    for(size_t i = 0; i < N; i++) {
+        if(gpuRes->offsets[i] != hostRes->offsets[i]) bad++;
+        if(gpuRes->keys[i] != hostRes->keys[i]) bad++;
+    }
+    for(size_t i = 0; i < BINS; i++) {
+        if(gpuRes->hist[i] != hostRes->hist[i]) bad++;
+    }
+
+    // compaction keeps order, so selected items match too
+    if(gpuRes->selectedCount != hostRes->selectedCount) bad++;
+    for(size_t i = 0; i < hostRes->selectedCount && i < N; i++) {
+        if(gpuRes->selected[i] != hostRes->selected[i]) bad++;
+    }
+
+    // float sums differ by order of additions
+    float diff = gpuRes->total - hostRes->total;
+    if(diff < 0) diff = -diff;
+
+    // output
+    printf("reduce: %f (host %f)\n", gpuRes->total, hostRes->total);
+    printf("selected: %u (host %u)\n", gpuRes->selectedCount, hostRes->selectedCount);
+    printf("mismatches: %zu\n", bad);
+
+    bool ok = err == ECL_ERROR_OK && hostErr == ECL_ERROR_OK && bad == 0 && diff <= 1e-4f * hostRes->total;
+    printf("%s\n", ok ? "ok" : "failed");
+
+    // clean resources
+    eclComputerClear(&host);
+    eclComputerClear(&gpu);
+    eclPlatformClear(&plat);
+
+    free(gpuRes);
+    free(hostRes);
+
+    free(values);
+    free(counts);
+    free(ids);
+    free(flags);
+
+    return ok ? 0 : 1;
+}